@@ -0,0 +1,647 @@
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#include <endian.h>
+#include <netinet/in.h>
+#include "common.h"
+#include "board.h"
+#include "event_log.h"
+#include "gui.h"
+#include "metrics.h"
+#include "protocol.h"
+#include "room.h"
+#include "trig.h"
+
+/* Mikrobenchmarki gorących ścieżek serwera i klienta. Wynik to linie "nazwa wartość",
+ * wartość w nanosekundach na operację (przy planszy board_eat - na piksel). Ziarna są stałe,
+ * więc kolejne uruchomienia mierzą dokładnie tę samą pracę; tam, gdzie się da, podajemy
+ * minimum z BENCH_REPEATS powtórzeń. Każdy pomiar ma też linię "nazwa/allocs_per_op wartość"
+ * ze średnią liczbą alokacji (operator new) na operację w mierzonej pętli. */
+
+#define BENCH_REPEATS 5
+#define BENCH_ROUNDS 20000          // zmierzonych tur do_turn na konfigurację
+#define BENCH_HISTORY_REQUESTS 10000
+#define BENCH_DECODE_EVENTS 1000000
+#define RESET_REPEATS 16
+#define WALK_STEPS 4000000
+#define WALK_SNAKES 25
+#define RANDOM_TURN_CHANGE 8
+#define BENCH_TURNING_SPEED 6
+#define IN_FLIGHT_CHECK_ROUNDS 1000
+#define IN_FLIGHT_OBSERVERS 4
+#define KEYFRAME_CHECK_PIXELS 40000
+#define FIXED_CHECK_TRAJECTORIES 10000
+#define FIXED_CHECK_ROUNDS_MAX 100000   // trasa kręcąca się w kółko może nie opuścić planszy
+#define FIXED_CHECK_MISMATCHES_MAX 50   // 0.5% tras, zmierzone ok. 0.2% (trig.h)
+
+namespace {
+    volatile uint64_t sink;
+    uint64_t allocations = 0;   // wywołania operator new, bench jest jednowątkowy
+
+    /* wysłane przez pokoje bench_room_t datagramy, żeby sprawdzić, że wysyłanie naprawdę zaszło */
+    struct sent_t {
+        uint64_t msgs = 0;
+        uint64_t bytes = 0;
+    };
+    sent_t sent;
+
+    struct measurement_t {
+        double ns_per_op;
+        double allocs_per_op;
+    };
+
+    double elapsed_ns(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void report(const std::string &name, double ns_per_op) {
+        printf("%s %.2f\n", name.c_str(), ns_per_op);
+    }
+
+    void report(const std::string &name, measurement_t measurement) {
+        report(name, measurement.ns_per_op);
+        report(name + "/allocs_per_op", measurement.allocs_per_op);
+    }
+
+    /* najlepszy z BENCH_REPEATS czasów wykonania body, w ns na jedną z ops operacji,
+     * i średnia liczba alokacji na operację ze wszystkich powtórzeń */
+    template<typename F>
+    measurement_t measure(uint64_t ops, F &&body) {
+        double best = 0;
+        uint64_t first_allocation = allocations;
+        for (int r = 0; r < BENCH_REPEATS; r++) {
+            auto start = std::chrono::steady_clock::now();
+            body();
+            double ns = elapsed_ns(start) / (double) ops;
+            if (r == 0 || ns < best)
+                best = ns;
+        }
+        return {best, (double) (allocations - first_allocation) / (double) (ops * BENCH_REPEATS)};
+    }
+
+    std::string board_name(uint32_t width, uint32_t height) {
+        return std::to_string(width) + "x" + std::to_string(height);
+    }
+
+    /* Wszystkie jądra crc muszą dawać wynik crc32_reference, także crc32_update i crc32_combine
+     * przy dowolnym podziale bufora; rozbieżność kończy bench przez fatal. Rozmiary i przesunięcia
+     * pokrywają ogony krótsze niż blok slicing-by-8 i niż 64-bajtowy blok clmul. */
+    void check_crc(const std::vector<char> &buf) {
+        for (size_t offset = 0; offset < 8; offset++) {
+            for (size_t size = 0; size <= 1024; size++) {
+                const char *data = buf.data() + offset;
+                uint32_t expected = crc32_reference(data, size);
+                if (crc32buf(data, size) != expected || crc32_slice8(data, size) != expected ||
+                    crc32_clmul(data, size) != expected)
+                    fatal("crc32 kernel mismatch, size %zu offset %zu", size, offset);
+
+                size_t split = size / 3;
+                uint32_t head = crc32buf(data, split);
+                if (crc32_update(head, data + split, size - split) != expected ||
+                    crc32_combine(head, crc32buf(data + split, size - split), size - split) != expected)
+                    fatal("crc32 update/combine mismatch, size %zu split %zu", size, split);
+            }
+        }
+    }
+
+    template<typename F>
+    void bench_crc_kernel(const std::string &name, const std::vector<char> &buf, F &&kernel) {
+        for (size_t size : {16, 64, 256, 550, 4096, 65536}) {
+            uint64_t ops = std::max<uint64_t>(1000, ((uint64_t) 1 << 26) / size);
+            report(name + "/" + std::to_string(size), measure(ops, [&] {
+                uint32_t crc = 0;
+                for (uint64_t i = 0; i < ops; i++)
+                    crc ^= kernel(buf.data(), size);
+                sink = sink + crc;
+            }));
+        }
+    }
+
+    void bench_crc() {
+        std::vector<char> buf(65536);
+        std::mt19937_64 rand(42);
+        for (char &c : buf)
+            c = (char) rand();
+        check_crc(buf);
+
+        bench_crc_kernel("crc32buf", buf, crc32buf);
+        bench_crc_kernel("crc32_reference", buf, crc32_reference);
+        bench_crc_kernel("crc32_slice8", buf, crc32_slice8);
+        if (crc32_clmul_supported())    // inaczej crc32_clmul to tylko slicing-by-8
+            bench_crc_kernel("crc32_clmul", buf, crc32_clmul);
+    }
+
+    /* Test równoważności ruchu stałoprzecinkowego z ruchem na double dla domyślnego
+     * turning_speed: losowe trasy (start jak w init_game, losowe skręty) liczone obydwoma
+     * sposobami aż do wyjścia poza planszę. Na każdej turze różnica pozycji musi mieścić się
+     * w ograniczeniu z trig.h, a tras, na których pole planszy choć raz się różni, może być
+     * najwyżej FIXED_CHECK_MISMATCHES_MAX; inaczej fatal. */
+    void check_fixed_movement(uint32_t width, uint32_t height) {
+        const direction_step_t *steps = direction_steps();
+        const fixed_step_t *fixed_steps = fixed_direction_steps();
+        uint64_t rand = 42;
+        auto next_random = [&rand] {
+            rand = rand * 6364136223846793005ULL + 1442695040888963407ULL;
+            return rand >> 33;
+        };
+
+        uint64_t mismatches = 0;
+        for (int t = 0; t < FIXED_CHECK_TRAJECTORIES; t++) {
+            uint32_t start_x = next_random() % width;
+            uint32_t start_y = next_random() % height;
+            int16_t direction = next_random() % 360;
+            double x = start_x + 0.5;
+            double y = start_y + 0.5;
+            int64_t fixed_x = fixed_from_cell(start_x);
+            int64_t fixed_y = fixed_from_cell(start_y);
+            uint8_t turn = 0;
+            bool mismatch = false;
+
+            for (int round = 1; round <= FIXED_CHECK_ROUNDS_MAX; round++) {
+                if (next_random() % 16 == 0)
+                    turn = next_random() % 3;   // prosto, w prawo, w lewo
+                if (turn == TURN_RIGHT)
+                    direction += BENCH_TURNING_SPEED;
+                else if (turn == TURN_LEFT)
+                    direction -= BENCH_TURNING_SPEED;
+
+                uint32_t cell_x = (x += direction_step(steps, direction).dx);
+                uint32_t cell_y = (y += direction_step(steps, direction).dy);
+                fixed_x += fixed_direction_step(fixed_steps, direction).dx;
+                fixed_y += fixed_direction_step(fixed_steps, direction).dy;
+
+                double bound = std::ldexp((double) round, -FIXED_FRACTION_BITS);
+                if (std::fabs(x - std::ldexp((double) fixed_x, -FIXED_FRACTION_BITS)) >= bound ||
+                    std::fabs(y - std::ldexp((double) fixed_y, -FIXED_FRACTION_BITS)) >= bound)
+                    fatal("fixed-point position drifted from the double path after %d rounds", round);
+
+                if (cell_x != fixed_to_cell(fixed_x) || cell_y != fixed_to_cell(fixed_y))
+                    mismatch = true;
+                if (cell_x > width - 1 || cell_y > height - 1)
+                    break;
+            }
+            mismatches += mismatch;
+        }
+
+        if (mismatches > FIXED_CHECK_MISMATCHES_MAX)
+            fatal("fixed-point cells differ from the double path on %lu of %d trajectories",
+                  (unsigned long) mismatches, FIXED_CHECK_TRAJECTORIES);
+    }
+
+    /* deterministyczne ścieżki: każdy wąż idzie prosto i co jakiś czas skręca o 90 stopni,
+     * zawijając się na brzegach planszy */
+    struct walk_t {
+        std::vector<uint32_t> xs, ys;
+    };
+
+    walk_t make_walk(uint32_t width, uint32_t height) {
+        walk_t walk;
+        uint64_t rand = 42;
+        uint32_t x[WALK_SNAKES], y[WALK_SNAKES], dir[WALK_SNAKES];
+        for (int s = 0; s < WALK_SNAKES; s++) {
+            rand = rand * 6364136223846793005ULL + 1442695040888963407ULL;
+            x[s] = (rand >> 33) % width;
+            y[s] = (rand >> 13) % height;
+            dir[s] = (rand >> 7) % 4;
+        }
+        static const int dx[] = {1, 0, -1, 0}, dy[] = {0, 1, 0, -1};
+        for (int i = 0; i < WALK_STEPS; i++) {
+            int s = i % WALK_SNAKES;
+            rand = rand * 6364136223846793005ULL + 1442695040888963407ULL;
+            if ((rand >> 40) % 16 == 0)
+                dir[s] = (dir[s] + ((rand >> 50) & 1 ? 1 : 3)) % 4;
+            x[s] = (x[s] + width + dx[dir[s]]) % width;
+            y[s] = (y[s] + height + dy[dir[s]]) % height;
+            walk.xs.push_back(x[s]);
+            walk.ys.push_back(y[s]);
+        }
+        return walk;
+    }
+
+    /* plansza board_t w porównaniu z dawnym std::vector<bool>: czyszczenie między grami
+     * i zjadanie pól wzdłuż ścieżek węży */
+    void bench_board(uint32_t width, uint32_t height) {
+        std::vector<bool> vboard(width * height);
+        board_t board;
+        board_init(board, width, height);
+        walk_t walk = make_walk(width, height);
+        std::string name = board_name(width, height);
+
+        report("board_reset/vector_bool/" + name, measure(RESET_REPEATS, [&] {
+            for (int r = 0; r < RESET_REPEATS; r++) {
+                for (size_t i = 0; i < vboard.size(); i++)
+                    vboard[i] = false;
+                sink = sink + vboard[r];
+            }
+        }));
+        report("board_reset/board_t/" + name, measure(RESET_REPEATS, [&] {
+            for (int r = 0; r < RESET_REPEATS; r++) {
+                board_clear(board);
+                sink = sink + board_test(board, r, 0);
+            }
+        }));
+
+        uint64_t eaten = 0, board_eaten = 0;
+        report("board_eat/vector_bool/" + name, measure(walk.xs.size(), [&] {
+            vboard.assign(vboard.size(), false);
+            eaten = 0;
+            for (size_t i = 0; i < walk.xs.size(); i++) {
+                size_t index = walk.ys[i] * width + walk.xs[i];
+                if (vboard[index])
+                    eaten++;
+                else
+                    vboard[index] = true;
+            }
+        }));
+        report("board_eat/board_t/" + name, measure(walk.xs.size(), [&] {
+            board_clear(board);
+            board_eaten = 0;
+            for (size_t i = 0; i < walk.xs.size(); i++)
+                board_eaten += board_test_and_set(board, walk.xs[i], walk.ys[i]);
+        }));
+
+        if (eaten != board_eaten)
+            fprintf(stderr, "board mismatch: %lu != %lu\n", (unsigned long) eaten, (unsigned long) board_eaten);
+        sink = sink + eaten;
+    }
+
+    void discard_sends(room_t &, mmsghdr *msgs, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            const msghdr &hdr = msgs[i].msg_hdr;
+            for (size_t v = 0; v < hdr.msg_iovlen; v++)
+                sent.bytes += hdr.msg_iov[v].iov_len;
+        }
+        sent.msgs += count;
+    }
+
+    /* pokój bez gniazda, z wysyłaniem w próżnię i klientami symulowanymi wywołaniami
+     * room_handle_client_msg */
+    struct bench_room_t {
+        room_t room;
+        metrics_t metrics;
+        std::vector<std::string> names;
+        std::vector<uint8_t> directions;
+        std::vector<sockaddr_in6> addresses;
+    };
+
+    std::unique_ptr<bench_room_t> make_room(uint32_t width, uint32_t height, int clients) {
+        auto bench = std::make_unique<bench_room_t>();
+        room_init(bench->room, 0, -1, {BENCH_TURNING_SPEED, 50, (int) width, (int) height, false}, 7);
+        bench->room.send = discard_sends;
+        bench->room.metrics = &bench->metrics;
+        for (int i = 0; i < clients; i++) {
+            sockaddr_in6 address{};
+            address.sin6_family = AF_INET6;
+            address.sin6_addr = in6addr_loopback;
+            address.sin6_port = htons(20000 + i);
+            bench->addresses.push_back(address);
+        }
+        return bench;
+    }
+
+    void send_client_msg(bench_room_t &bench, int client, uint8_t direction, uint32_t expected_event_no,
+                         const std::string &name) {
+        client_msg msg{};
+        size_t len = client_msg_encode(msg, client + 1, direction, expected_event_no, name);
+        room_handle_client_msg(bench.room, msg, (int) len, bench.addresses[client]);
+    }
+
+    /* Tury gry z players graczami skręcającymi losowo. do_turn mierzy sam pokój (metryka
+     * turn_ns), round - całą obsługę tury razem z pakowaniem eventów dla odbiorców, init_game -
+     * turę rozpoczynającą grę (czyszczenie planszy, new_game i pozycje startowe). */
+    void bench_rounds(int players, uint32_t width, uint32_t height) {
+        auto bench = make_room(width, height, players);
+        room_t &room = bench->room;
+        std::mt19937_64 rand(players * 7919 + width);
+        for (int i = 0; i < players; i++) {
+            bench->names.push_back("player" + std::to_string(i));
+            bench->directions.push_back(TURN_RIGHT);
+        }
+
+        uint64_t round_ns = 0, rounds = 0, init_ns = 0, inits = 0, round_allocations = 0;
+        sent_t sent_before = sent;
+        while (rounds < BENCH_ROUNDS) {
+            // co turę, żeby nikt nie przekroczył czasu; bez historii, bo klienci są na bieżąco
+            for (int i = 0; i < players; i++) {
+                uint8_t &direction = bench->directions[i];
+                if (!room.game_in_progress)
+                    direction = TURN_RIGHT;     // zgłoszenie gotowości
+                else if (rand() % RANDOM_TURN_CHANGE == 0)
+                    direction = rand() % 3;
+                send_client_msg(*bench, i, direction, event_log_count(room.game_events), bench->names[i]);
+            }
+
+            bool in_progress = room.game_in_progress;
+            uint64_t first_allocation = allocations;
+            uint64_t start = metrics_now_ns();
+            room_handle_round(room, 1);
+            uint64_t elapsed = metrics_now_ns() - start;
+            if (in_progress) {
+                round_ns += elapsed;
+                round_allocations += allocations - first_allocation;
+                rounds++;
+            } else if (room.game_in_progress) {
+                init_ns += elapsed;
+                inits++;
+            }
+        }
+
+        std::string suffix = "/" + std::to_string(players) + "p/" + board_name(width, height);
+        uint64_t turns = bench->metrics.turn_ns.count.value.load();
+        report("do_turn" + suffix, (double) bench->metrics.turn_ns.sum.value.load() / (double) turns);
+        report("round" + suffix, {(double) round_ns / (double) rounds, (double) round_allocations / (double) rounds});
+        report("init_game" + suffix, (double) init_ns / (double) inits);
+        if (sent.msgs == sent_before.msgs || sent.bytes == sent_before.bytes)
+            fatal("round%s sent no datagrams", suffix.c_str());
+    }
+
+    void append_pixels(event_log_t &log, uint32_t count, uint32_t width, uint32_t height) {
+        std::mt19937_64 rand(count);
+        for (uint32_t i = 0; i < count; i++) {
+            event_pixel pixel{htobe32(1), htobe32(sizeof(event_pixel) - 12), htobe32(event_log_count(log)),
+                              TYPE_PIXEL, (uint8_t) (i % MAX_PLAYERS),
+                              htobe32(rand() % width), htobe32(rand() % height), 0};
+            pixel.crc32 = htobe32(crc32buf((char *) &pixel + 4, sizeof(pixel) - 8));
+            event_log_append(log, &pixel, sizeof(pixel));
+        }
+    }
+
+    /* Żądania historii od losowych miejsc długiego logu: samo wyznaczenie datagramów
+     * (event_log_history) i pełna obsługa komunikatu obserwatora z send_history. */
+    void bench_history(uint32_t events) {
+        auto bench = make_room(640, 480, 1);
+        room_t &room = bench->room;
+        append_pixels(room.game_events, events, 640, 480);
+        std::string suffix = "/" + std::to_string(events);
+
+        std::vector<uint32_t> firsts;
+        std::mt19937_64 rand(events);
+        for (int i = 0; i < BENCH_HISTORY_REQUESTS; i++)
+            firsts.push_back(rand() % events);
+
+        std::vector<iovec> iovs;
+        report("event_log_history" + suffix, measure(BENCH_HISTORY_REQUESTS, [&] {
+            for (uint32_t first : firsts)
+                sink = sink + event_log_history(room.game_events, first, iovs, HISTORY_DATAGRAMS_MAX);
+        }));
+        sent_t sent_before = sent;
+        report("send_history" + suffix, measure(BENCH_HISTORY_REQUESTS, [&] {
+            for (uint32_t first : firsts)
+                send_client_msg(*bench, 0, 0, first, "");
+        }));
+        // każde żądanie jest od miejsca w logu, więc dostaje co najmniej jeden datagram
+        if (sent.msgs - sent_before.msgs < (uint64_t) BENCH_HISTORY_REQUESTS * BENCH_REPEATS)
+            fatal("send_history%s sent %lu datagrams for %d requests", suffix.c_str(),
+                  (unsigned long) (sent.msgs - sent_before.msgs), BENCH_HISTORY_REQUESTS * BENCH_REPEATS);
+    }
+
+    /* wysłane, ale jeszcze nie zakończone (jak przy io_uring) komunikaty: dane i ich kopia */
+    struct in_flight_t {
+        const char *data;
+        std::string copy;
+    };
+    std::vector<in_flight_t> in_flight;
+
+    void record_sends(room_t &room, mmsghdr *msgs, size_t count) {
+        discard_sends(room, msgs, count);
+        for (size_t i = 0; i < count; i++) {
+            const msghdr &hdr = msgs[i].msg_hdr;
+            for (size_t v = 0; v < hdr.msg_iovlen; v++) {
+                const char *data = (const char *) hdr.msg_iov[v].iov_base;
+                in_flight.push_back({data, std::string(data, hdr.msg_iov[v].iov_len)});
+            }
+        }
+    }
+
+    void check_in_flight(const char *when) {
+        for (const in_flight_t &send : in_flight) {
+            if (memcmp(send.data, send.copy.data(), send.copy.size()) != 0)
+                fatal("data of an in-flight send changed %s", when);
+        }
+    }
+
+    /* prośba obserwatora o historię; odpowiedź nie może przekroczyć HISTORY_DATAGRAMS_MAX */
+    void send_history_request(bench_room_t &bench, int client, uint32_t expected_event_no) {
+        sent_t sent_before = sent;
+        send_client_msg(bench, client, CLIENT_CAP_KEYFRAME, expected_event_no, "");
+        if (sent.msgs - sent_before.msgs > HISTORY_DATAGRAMS_MAX)
+            fatal("history request from %x sent %lu datagrams", expected_event_no,
+                  (unsigned long) (sent.msgs - sent_before.msgs));
+    }
+
+    /* Kontrakt room_send_t: dane wysłanych komunikatów żyją do następnej tury pokoju. Gra
+     * z obserwatorami, którzy między turami proszą o historię (także o klatkę planszy i jej
+     * dalsze strony), a żadne wysyłanie nie kończy się przed turą; po każdym żądaniu dane
+     * wszystkich wcześniejszych komunikatów muszą być nienaruszone, inaczej fatal. */
+    void check_history_in_flight() {
+        auto bench = make_room(2048, 2048, MAX_PLAYERS + IN_FLIGHT_OBSERVERS);
+        room_t &room = bench->room;
+        room.send = record_sends;
+        std::mt19937_64 rand(11);
+        for (int i = 0; i < MAX_PLAYERS; i++) {
+            bench->names.push_back("player" + std::to_string(i));
+            bench->directions.push_back(TURN_RIGHT);
+        }
+
+        uint64_t keyframe_histories = 0;
+        for (int round = 0; round < IN_FLIGHT_CHECK_ROUNDS; round++) {
+            for (int i = 0; i < MAX_PLAYERS; i++) {
+                uint8_t &direction = bench->directions[i];
+                if (!room.game_in_progress)
+                    direction = TURN_RIGHT;
+                else if (rand() % RANDOM_TURN_CHANGE == 0)
+                    direction = rand() % 3;
+                send_client_msg(*bench, i, direction, event_log_count(room.game_events), bench->names[i]);
+            }
+
+            /* ćwierć obserwatorów dołącza od zera (klatka), ćwierć prosi o losową stronę
+             * fragmentów, reszta o losowe miejsce logu */
+            for (int o = 0; o < IN_FLIGHT_OBSERVERS; o++) {
+                uint32_t count = event_log_count(room.game_events);
+                uint32_t fragment_count = event_log_count(room.keyframe.fragments);
+                uint32_t expected = 0;
+                if (o >= IN_FLIGHT_OBSERVERS / 2 && count != 0)
+                    expected = rand() % count;
+                else if (o >= IN_FLIGHT_OBSERVERS / 4)
+                    expected = KEYFRAME_REQUEST | (uint32_t) (rand() % (fragment_count + 1));
+                if ((expected == 0 || (expected & KEYFRAME_REQUEST)) && room.game_in_progress &&
+                    room.keyframe.event_no != 0)
+                    keyframe_histories++;
+                send_history_request(*bench, MAX_PLAYERS + o, expected);
+                check_in_flight("by a history request");
+            }
+
+            check_in_flight("before the round");
+            in_flight.clear();  // backend io_uring zaczyna turę dopiero, gdy nic nie jest w locie
+            room_handle_round(room, 1);
+        }
+
+        if (keyframe_histories == 0)
+            fatal("no history request was served from a keyframe");
+    }
+
+    /* Obserwator z -k zbiera klatkę długiej gry (log dopełniony losowymi pikselami) stronami:
+     * prośba od zera, potem KEYFRAME_REQUEST od pierwszego brakującego fragmentu. Klatka musi
+     * się skompletować w tylu prośbach, ile ma stron, inaczej fatal. */
+    void check_keyframe_pages() {
+        auto bench = make_room(640, 480, 3);
+        room_t &room = bench->room;
+        room.send = record_sends;
+        for (int i = 0; i < 2; i++)
+            send_client_msg(*bench, i, TURN_RIGHT, 0, "player" + std::to_string(i));
+        room_handle_round(room, 1);
+        if (!room.game_in_progress)
+            fatal("keyframe check game did not start");
+        append_pixels(room.game_events, KEYFRAME_CHECK_PIXELS, 640, 480);
+        send_history_request(*bench, 2, 0);     // zamawia klatkę, powstanie w turze
+        room_handle_round(room, 1);
+
+        uint32_t fragment_count = event_log_count(room.keyframe.fragments);
+        if (fragment_count <= HISTORY_DATAGRAMS_MAX)
+            fatal("keyframe of %u fragments fits in a page", fragment_count);
+        std::vector<bool> received(fragment_count);
+        uint32_t next = 0;
+        uint32_t requests = 0;
+        while (next < fragment_count) {
+            if (requests++ > fragment_count / (HISTORY_DATAGRAMS_MAX - 1) + 1)
+                fatal("keyframe of %u fragments not complete after %u requests", fragment_count, requests - 1);
+            in_flight.clear();
+            send_history_request(*bench, 2, requests == 1 ? 0 : KEYFRAME_REQUEST | next);
+            for (const in_flight_t &send : in_flight) {
+                event_view_t event{};
+                if (event_parse(send.copy.data(), send.copy.size(), event) == 0 || event.type != TYPE_KEYFRAME)
+                    continue;
+                event_keyframe header;
+                memcpy(&header, event.data, sizeof(header));
+                received[be16toh(header.fragment_no)] = true;
+            }
+            while (next < fragment_count && received[next])
+                next++;
+        }
+        in_flight.clear();
+    }
+
+    /* event new_game z players graczami dokładnie w postaci od serwera */
+    std::vector<char> make_new_game(int players) {
+        std::string list;
+        for (int i = 0; i < players; i++) {
+            list += "player" + std::to_string(i);
+            list += '\0';
+        }
+        uint32_t len = 13 + list.size();
+        std::vector<char> event(len + 12);
+        event_new_game *header = (event_new_game *) event.data();
+        header->game_id = htobe32(1);
+        header->len = htobe32(len);
+        header->event_no = 0;
+        header->event_type = TYPE_NEW_GAME;
+        header->maxx = htobe32(640);
+        header->maxy = htobe32(480);
+        memcpy(event.data() + 21, list.data(), list.size());
+        uint32_t crc = htobe32(crc32buf(event.data() + 4, len + 4));
+        memcpy(event.data() + len + 8, &crc, sizeof(crc));
+        return event;
+    }
+
+    /* dekodowanie eventów w kliencie razem z formatowaniem linii dla gui; funkcje z gui.h
+     * dopisują do bufora, więc przed każdym eventem jest czyszczony (pojemność zostaje) */
+    void bench_decode() {
+        std::vector<char> new_game = make_new_game(MAX_PLAYERS);
+        gui_game_t game;
+        std::string msg_to_gui;
+        event_view_t event{};
+
+        report("client_decode/new_game/" + std::to_string(MAX_PLAYERS) + "p",
+               measure(BENCH_DECODE_EVENTS / 10, [&] {
+                   for (int i = 0; i < BENCH_DECODE_EVENTS / 10; i++) {
+                       event_parse(new_game.data(), new_game.size(), event);
+                       msg_to_gui.clear();
+                       gui_new_game(game, event, msg_to_gui);
+                   }
+                   sink = sink + msg_to_gui.size();
+               }));
+
+        event_log_t pixels;
+        append_pixels(pixels, BENCH_DECODE_EVENTS, 640, 480);
+        report("event_parse/pixel", measure(BENCH_DECODE_EVENTS, [&] {
+            for (uint32_t i = 0; i < BENCH_DECODE_EVENTS; i++)
+                sink = sink + event_parse(event_log_at(pixels, i), sizeof(event_pixel), event);
+        }));
+        report("client_decode/pixel", measure(BENCH_DECODE_EVENTS, [&] {
+            for (uint32_t i = 0; i < BENCH_DECODE_EVENTS; i++) {
+                event_parse(event_log_at(pixels, i), sizeof(event_pixel), event);
+                msg_to_gui.clear();
+                gui_pixel(game, event, msg_to_gui);
+            }
+            sink = sink + msg_to_gui.size();
+        }));
+
+        event_player_eliminated eliminated{htobe32(1), htobe32(sizeof(event_player_eliminated) - 12), htobe32(1),
+                                           TYPE_PLAYER_ELIMINATED, MAX_PLAYERS - 1, 0};
+        eliminated.crc32 = htobe32(crc32buf((char *) &eliminated + 4, sizeof(eliminated) - 8));
+        report("client_decode/player_eliminated", measure(BENCH_DECODE_EVENTS, [&] {
+            for (uint32_t i = 0; i < BENCH_DECODE_EVENTS; i++) {
+                event_parse((char *) &eliminated, sizeof(eliminated), event);
+                msg_to_gui.clear();
+                gui_player_eliminated(game, event, msg_to_gui);
+            }
+            sink = sink + msg_to_gui.size();
+        }));
+    }
+}
+
+void *operator new(size_t size) {
+    allocations++;
+    if (void *ptr = malloc(size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+    free(ptr);
+}
+
+int main() {
+    bench_crc();
+    check_fixed_movement(640, 480);
+
+    for (auto [width, height] : {std::pair(640u, 480u), std::pair(2048u, 2048u), std::pair(4096u, 4096u)})
+        bench_board(width, height);
+
+    for (auto [width, height] : {std::pair(640u, 480u), std::pair(2048u, 2048u)}) {
+        for (int players : {2, 5, 10, 25})
+            bench_rounds(players, width, height);
+    }
+
+    for (uint32_t events : {1000u, 100000u, 1000000u})
+        bench_history(events);
+
+    check_history_in_flight();
+    check_keyframe_pages();
+    bench_decode();
+    return 0;
+}
@@ -0,0 +1,19 @@
+#include <algorithm>
+#include "board.h"
+
+void board_init(board_t &board, uint32_t width, uint32_t height) {
+    board.width = width;
+    board.height = height;
+    board.words_per_row = (width + 63) / 64;
+    board.epoch = 1;
+    board.words.assign((size_t) board.words_per_row * height, 0);
+    board.row_epoch.assign(height, 0);
+}
+
+void board_clear(board_t &board) {
+    if (++board.epoch == 0) {
+        // licznik epok się przekręcił, raz na 2^32 gier czyścimy naprawdę
+        std::fill(board.row_epoch.begin(), board.row_epoch.end(), 0);
+        board.epoch = 1;
+    }
+}
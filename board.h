@@ -0,0 +1,48 @@
+#ifndef SIK2_BOARD_H
+#define SIK2_BOARD_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+/* Plansza jako bitset w słowach 64-bitowych, każdy wiersz zaczyna się od nowego słowa.
+ * Czyszczenie między grami jest O(1): wiersz pamięta epokę, w której był ostatnio
+ * zapisywany, wiersz z wcześniejszej epoki jest traktowany jak pusty i zerowany
+ * dopiero przy pierwszym zapisie w nowej grze. */
+struct board_t {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t words_per_row = 0;
+    uint32_t epoch = 1;
+    std::vector<uint64_t> words;
+    std::vector<uint32_t> row_epoch;
+};
+
+void board_init(board_t &board, uint32_t width, uint32_t height);
+
+/* czyści całą planszę (nowa epoka) */
+void board_clear(board_t &board);
+
+/* x < width, y < height */
+inline bool board_test(const board_t &board, uint32_t x, uint32_t y) {
+    if (board.row_epoch[y] != board.epoch)
+        return false;
+    return (board.words[(size_t) y * board.words_per_row + x / 64] >> (x % 64)) & 1;
+}
+
+/* zjada pole (x, y) i zwraca, czy było już zjedzone; x < width, y < height */
+inline bool board_test_and_set(board_t &board, uint32_t x, uint32_t y) {
+    uint64_t *row = board.words.data() + (size_t) y * board.words_per_row;
+    if (board.row_epoch[y] != board.epoch) {
+        memset(row, 0, board.words_per_row * sizeof(uint64_t));
+        board.row_epoch[y] = board.epoch;
+    }
+    uint64_t bit = (uint64_t) 1 << (x % 64);
+    uint64_t &word = row[x / 64];
+    bool eaten = (word & bit) != 0;
+    word |= bit;
+    return eaten;
+}
+
+#endif //SIK2_BOARD_H
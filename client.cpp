@@ -1,4 +1,3 @@
-#include <iostream>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
@@ -10,23 +9,30 @@
 #include <fcntl.h>
 #include <utmpx.h>
 #include <poll.h>
-#include <map>
+#include <vector>
+#include <string>
 #include "common.h"
+#include "log.h"
+#include "protocol.h"
+#include "gui.h"
+#include "reorder.h"
 
 #define MAX_CONSECUTIVE_SERVER_MSG 250
 #define MAX_CONSECUTIVE_GUI_MSG 50
 #define COMMAND_BUF_SIZE 100
+#define GUI_OUTPUT_HIGH_WATER (1 << 20)  // bajtów czekających na gui, powyżej nie czytamy od serwera
 
 namespace {
     uint64_t session_id;
-    uint32_t current_game_id = 0;
+    bool has_game = false;
+    uint32_t current_game_id = 0;   // gra z ostatniego new_game (także już zakończona)
     uint32_t expected_event_no = 0;
-    uint32_t last_event_no = 0; // event 0 nigdy nie bedzie game_overem, 0 tutaj to placeholder
     uint8_t turn_direction = 0;
-    uint32_t maxx, maxy, player_count;
     int last_key_down = 0;
+    uint8_t capabilities = 0;   // dokładane do turn_direction w komunikatach do serwera
 
     int server_sock, gui_sock;
+    int multicast_sock = -1;
     std::string player_name;
     char *server;
     char *server_port = NULL;
@@ -35,10 +41,50 @@ namespace {
     char default_gui_addr[] = "localhost";
     char default_server_port[] = "2021";
     char default_gui_port[] = "20210";
+    char *multicast_group = NULL;  // z -g eventy na żywo przychodzą z tej grupy, serwer tylko uzupełnia braki
+    int multicast_port = DEFAULT_MULTICAST_PORT;
+
+    reorder_window_t<gui_event_t> reorder_window;
+    gui_game_t game;
+
+    /* Linie dla gui zebrane w jednym obrocie pętli (funkcje z gui.h formatują je wprost tutaj,
+     * więc po rozgrzaniu bufora nic nie jest alokowane), wysyłane jednym send. Czego gniazdo nie
+     * przyjęło, czeka tutaj (poll z POLLOUT) - nic nie jest gubione, a przy zaległościach
+     * powyżej GUI_OUTPUT_HIGH_WATER klient przestaje odbierać eventy, aż gui nadrobi. */
+    struct gui_output_t {
+        std::string data;
+        size_t sent = 0;
+    };
+    gui_output_t gui_output;
+
+    inline size_t gui_output_pending() {
+        return gui_output.data.size() - gui_output.sent;
+    }
+
+    void gui_output_flush() {
+        while (gui_output_pending() > 0) {
+            ssize_t ret = send(gui_sock, gui_output.data.data() + gui_output.sent, gui_output_pending(),
+                               MSG_NOSIGNAL);
+            if (ret == -1) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    break;  // dokończymy, gdy poll zgłosi POLLOUT
+                syserr("write gui");
+            }
+            gui_output.sent += ret;
+        }
+
+        if (gui_output.sent == gui_output.data.size()) {
+            gui_output.data.clear();
+            gui_output.sent = 0;
+        } else if (gui_output.sent > gui_output.data.size() / 2) {
+            gui_output.data.erase(0, gui_output.sent);
+            gui_output.sent = 0;
+        }
+    }
 
     void get_args(int argc, char *argv[]) {
         int opt;
-        while ((opt = getopt(argc, argv, "n:p:i:r:")) != -1) {
+        while ((opt = getopt(argc, argv, "n:p:i:r:kg:G:")) != -1) {
             switch (opt) {
                 case 'n':
                     player_name = optarg;
@@ -61,12 +107,24 @@ namespace {
                     if (atoi(gui_port) < 2 || atoi(gui_port) > 65535)
                         fatal("invalid gui port argument");
                     break;
+                case 'k':
+                    capabilities |= CLIENT_CAP_KEYFRAME;
+                    break;
+                case 'g':
+                    multicast_group = optarg;
+                    capabilities |= CLIENT_CAP_MULTICAST;
+                    break;
+                case 'G':
+                    multicast_port = atoi(optarg);
+                    if (multicast_port < 2 || multicast_port > 65535)
+                        fatal("invalid multicast port argument");
+                    break;
                 default:
-                    fatal("Arguments: game_server [-n player_name] [-p n] [-i gui_server] [-r n]\n");
+                    fatal("Arguments: game_server [-n player_name] [-p n] [-i gui_server] [-r n] [-k] [-g group] [-G n]\n");
             }
         }
         if (argc - optind != 0)
-            fatal("Arguments: game_server [-n player_name] [-p n] [-i gui_server] [-r n]\n");
+            fatal("Arguments: game_server [-n player_name] [-p n] [-i gui_server] [-r n] [-k] [-g group] [-G n]\n");
 
         if (gui_addr_arg == NULL)
             gui_addr_arg = default_gui_addr;
@@ -136,14 +194,69 @@ namespace {
             syserr("fcntl gui");
     }
 
+    /* gniazdo na porcie multicast_port zapisane do grupy; SO_REUSEADDR, żeby na jednym
+     * komputerze mogło słuchać kilku klientów */
+    void multicast_init() {
+        addrinfo addr_hints{};
+        addr_hints.ai_family = AF_UNSPEC;
+        addr_hints.ai_socktype = SOCK_DGRAM;
+        addr_hints.ai_protocol = IPPROTO_UDP;
+        addr_hints.ai_flags = AI_NUMERICHOST;
+        addrinfo *addr_result;
+        if (getaddrinfo(multicast_group, NULL, &addr_hints, &addr_result) != 0)
+            fatal("invalid multicast group argument");
+
+        int family = addr_result->ai_family;
+        multicast_sock = socket(family, SOCK_DGRAM, 0);
+        if (multicast_sock < 0)
+            syserr("socket multicast");
+
+        int on = 1;
+        if (setsockopt(multicast_sock, SOL_SOCKET, SO_REUSEADDR, (char *) &on, sizeof(on)) < 0)
+            syserr("setsockopt multicast");
+
+        if (family == AF_INET) {
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_port = htons(multicast_port);
+            address.sin_addr.s_addr = htonl(INADDR_ANY);
+            if (bind(multicast_sock, (sockaddr *) &address, sizeof(address)) == -1)
+                syserr("bind multicast");
+
+            ip_mreq request{};
+            request.imr_multiaddr = ((sockaddr_in *) addr_result->ai_addr)->sin_addr;
+            request.imr_interface.s_addr = htonl(INADDR_ANY);
+            if (setsockopt(multicast_sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &request, sizeof(request)) < 0)
+                syserr("join multicast group");
+        } else {
+            sockaddr_in6 address{};
+            address.sin6_family = AF_INET6;
+            address.sin6_port = htons(multicast_port);
+            address.sin6_addr = in6addr_any;
+            if (bind(multicast_sock, (sockaddr *) &address, sizeof(address)) == -1)
+                syserr("bind multicast");
+
+            ipv6_mreq request{};
+            request.ipv6mr_multiaddr = ((sockaddr_in6 *) addr_result->ai_addr)->sin6_addr;
+            request.ipv6mr_interface = ((sockaddr_in6 *) addr_result->ai_addr)->sin6_scope_id;
+            if (setsockopt(multicast_sock, IPPROTO_IPV6, IPV6_JOIN_GROUP, &request, sizeof(request)) < 0)
+                syserr("join multicast group");
+        }
+        freeaddrinfo(addr_result);
+
+        if (fcntl(multicast_sock, F_SETFL, fcntl(multicast_sock, F_GETFL, 0) | O_NONBLOCK) == -1)
+            syserr("fcntl multicast");
+    }
+
     void init_poll(pollfd client[]) {
-        for (int i = 0; i <= 2; i++) {
+        for (int i = 0; i <= 3; i++) {
             client[i].events = POLLIN;
             client[i].revents = 0;
         }
 
         client[0].fd = server_sock;
         client[1].fd = gui_sock;
+        client[3].fd = multicast_sock;  // -1 bez multicastu, poll go wtedy pomija
 
         create_timer(client[2].fd, TIMER_SEND_UPDATE, -1);
     }
@@ -173,102 +286,110 @@ namespace {
         }
     }
 
-    void send_ready_messages(int socket, std::map<uint32_t, std::string> &ready_messages) {
-        while (ready_messages.find(expected_event_no) != ready_messages.end()) {
-            auto pair = ready_messages.find(expected_event_no);
-            std::string msg_to_gui = pair->second;
-
-            write(socket, msg_to_gui.data(), msg_to_gui.size());
-
-            if (last_event_no != 0 && expected_event_no == last_event_no) {
-                // wysłaliśmy właśnie ostatni event w tej rozgrywce
-                expected_event_no = 0;
-                last_event_no = 0;
-                ready_messages.clear();
-                break;
-            }
+    /* Numer, od którego prosimy o historię. Z -k, dopóki po new_game nie dotarł ani event 1,
+     * ani cała klatka, prosimy o klatkę od pierwszego brakującego fragmentu (KEYFRAME_REQUEST):
+     * serwer odsyła kolejną stronę fragmentów, a gdy klatki nie ma, zwykłe eventy od 1. Od zera
+     * prosimy tylko przed new_game. */
+    uint32_t requested_event_no() {
+        if ((capabilities & CLIENT_CAP_KEYFRAME) && has_game && expected_event_no == 1)
+            return KEYFRAME_REQUEST | game.keyframe_next;
+        return expected_event_no;
+    }
 
+    /* wysyła do gui event równy expected_event_no i przesuwa oczekiwany numer */
+    void deliver_event(const gui_event_t &event) {
+        gui_event_format(game, event, gui_output.data);
+        if (event.type == TYPE_GAME_OVER)
+            expected_event_no = 0;  // koniec tej rozgrywki, czekamy na new_game następnej
+        else
             expected_event_no++;
-            ready_messages.erase(pair);
-        }
     }
 
-    void handle_new_game(uint32_t len, uint32_t event_no, const char *event_buf,
-                         std::string &msg_to_gui, std::map<uint8_t, std::string> &player_map) {
-        if (event_no != 0) {
-            std::cerr << "new game with nonzero event_no\n";
-            exit(1);
-        }
+    /* wysyła eventy z okna, które czekały na właśnie dostarczony */
+    void deliver_ready_events() {
+        const gui_event_t *event;
+        while (expected_event_no != 0 &&
+               (event = reorder_take(reorder_window, expected_event_no, current_game_id)) != nullptr)
+            deliver_event(*event);
+    }
 
-        maxx = be32toh(*(uint32_t *) (event_buf + 13));
-        maxy = be32toh(*(uint32_t *) (event_buf + 17));
+    void handle_new_game(const event_view_t &event) {
+        if (has_game && event.game_id == current_game_id)
+            return;     // powtórzony new_game bieżącej albo właśnie zakończonej gry
+        // inna gra również w trakcie bieżącej: jej koniec przepadł, a serwer już ją zapomniał
+        gui_new_game(game, event, gui_output.data);
+        has_game = true;
+        current_game_id = event.game_id;
+        expected_event_no = 1;
+        deliver_ready_events();
+    }
 
-        if (maxx > BOARD_WIDTH_MAX || maxy > BOARD_HEIGHT_MAX) {
-            std::cerr << "board too large\n";
-            exit(1);
-        }
-        msg_to_gui = "NEW_GAME " + std::to_string(maxx) + " " + std::to_string(maxy) + " ";
-
-        player_count = 0;
-        auto *player_names = event_buf + 21;
-        int i = 0;
-        int new_player_number = 0;
-        std::string new_player_name;
-        while (true) {
-            if (i >= len - 13) {
-                std::cerr << "player name list not null terminated\n";
-                exit(1);
-            }
-            auto c = player_names[i];
-            if ((c < 33 || c > 126) && c != '\0') {
-                std::cout << (int)c << std::endl;
-                std::cerr << "invalid char in player name list\n";
-                exit(1);
+    /* odbiera datagramy z eventami z gniazda serwera albo grupy multicast i przekazuje
+     * je do gui w kolejności event_no */
+    void receive_events(pollfd &server_poll) {
+        char buf[DATAGRAM_MAX_SIZE];
+        // limit żeby gra była responsive na input gracza, a gui nie zostawało w tyle
+        for (int t = 0; t < MAX_CONSECUTIVE_SERVER_MSG && gui_output_pending() < GUI_OUTPUT_HIGH_WATER; t++) {
+            int ret = read(server_poll.fd, buf, sizeof(buf));
+
+            if (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                // brak komunikatów do odebrania więc zerujemy revents
+                server_poll.revents = 0;
+                break;
             }
 
-            if (c == '\0') {
-                player_map.insert(std::pair(new_player_number, new_player_name));
-                new_player_name = "";
-                new_player_number++;
-                player_count++;
-
-                if (i == len - 14)
+            char *event_buf = buf;
+            while (ret > 0) {
+                event_view_t event{};
+                size_t event_size = event_parse(event_buf, ret, event);
+                if (event_size == 0) {
+                    LOG_DEBUG("truncated event or crc32 mismatch");
                     break;
+                }
 
-                msg_to_gui += " ";
-            } else {
-                msg_to_gui += c;
-                new_player_name += c;
-            }
-
-            i++;
-        }
-        msg_to_gui += '\n';
-    }
-
-    void handle_pixel(const char *event_buf, std::string &msg_to_gui,
-                      std::map<uint8_t, std::string> &player_map) {
-        uint8_t player_number = *(uint8_t *) (event_buf + 13);
-        if (player_number >= player_count) {
-            std::cerr << "player number too big\n";
-            exit(1);
-        }
+                uint32_t len = event.len;
+                uint32_t event_no = event.event_no;
+                uint8_t event_type = event.type;
+                LOG_DEBUG("event game id %u (mine %u) len %u number %u type %d", event.game_id,
+                          current_game_id, len, event_no, event_type);
 
-        uint32_t x = be32toh(*(uint32_t *) (event_buf + 14));
-        uint32_t y = be32toh(*(uint32_t *) (event_buf + 18));
+                bool current_game = has_game && event.game_id == current_game_id;
+                if (event_type == TYPE_NEW_GAME) {
+                    handle_new_game(event);
+                }
+                else if (event_type == TYPE_KEYFRAME) {
+                    // klatka zastępuje eventy [1, event_no), więc ma sens tylko tuż po new_game;
+                    // fragmenty sprzed new_game przepadają, serwer dośle je na prośbę od zera
+                    if (current_game && expected_event_no == 1 && event_no > 1) {
+                        bool complete = gui_keyframe(game, event, gui_output.data);
+                        if (complete) {
+                            expected_event_no = event_no;
+                            deliver_ready_events();
+                        }
+                    }
+                }
+                else {
+                    gui_event_t decoded;
+                    gui_event_decode(event, decoded);
+                    if (current_game && event_no == expected_event_no) {
+                        deliver_event(decoded);
+                        deliver_ready_events();
+                    }
+                    else if (event_no > expected_event_no && !reorder_insert(reorder_window, expected_event_no, decoded)) {
+                        LOG_DEBUG("event %u beyond the reorder window, waiting for history", event_no);
+                    }
+                }
 
-        if (x > maxx || y > maxy) {
-            std::cerr << "pixel outside board\n";
-            exit(1);
+                event_buf += event_size;
+                ret -= (int) event_size;
+            }
         }
-
-        msg_to_gui = "PIXEL " + std::to_string(x) + " " + std::to_string(y) + " " + player_map[player_number] + "\n";
     }
 }
 
 int main(int argc, char *argv[]) {
     if (argc < 2)
-        fatal("Arguments: game_server [-n player_name] [-p n] [-i gui_server] [-r n]\n");
+        fatal("Arguments: game_server [-n player_name] [-p n] [-i gui_server] [-r n] [-k] [-g group] [-G n]\n");
 
     timeval tv{};
     gettimeofday(&tv,NULL);
@@ -279,126 +400,43 @@ int main(int argc, char *argv[]) {
     get_args(argc - 1, argv + 1);
 
     net_init();
+    if (multicast_group != NULL)
+        multicast_init();
 
-    pollfd poll_arr[3];   // 0 - serwer, 1 - gui, 2 - timer
+    pollfd poll_arr[4];   // 0 - serwer, 1 - gui, 2 - timer, 3 - grupa multicast
     init_poll(poll_arr);
 
-    std::map<uint32_t, std::string> ready_messages;
-    std::map<uint8_t, std::string> player_map;
-    std::string msg_to_gui;
-
-    client_msg msg_to_server = {htobe64(session_id), turn_direction, htobe32(expected_event_no), 0};
-    for (int i = 0; i < player_name.size(); i++)
-        msg_to_server.player_name[i] = player_name[i];
-
-    write(server_sock, (char *)&msg_to_server, 13 + player_name.size());
+    client_msg msg_to_server{};
+    size_t msg_len = client_msg_encode(msg_to_server, session_id, turn_direction | capabilities,
+                                       requested_event_no(), player_name);
+    write(server_sock, (char *)&msg_to_server, msg_len);
 
     char command_buf[COMMAND_BUF_SIZE];    // na "LEFT_KEY_DOWN\n" itp
-    std::vector<int8_t >buf(DATAGRAM_MAX_SIZE);
-    std::cout << buf.size();
-
-    if (buf.data() == NULL)
-        syserr("vector alloc");
 
 #pragma clang diagnostic push
 #pragma ide diagnostic ignored "EndlessLoop"
     while (true) {
-        int ret = poll(poll_arr, 3, -1);
+        // przy zaległościach w gui nie czytamy od serwera, zgubione eventy przyjdą w historii
+        short server_events = gui_output_pending() < GUI_OUTPUT_HIGH_WATER ? POLLIN : 0;
+        poll_arr[0].events = server_events;
+        poll_arr[3].events = server_events;
+        poll_arr[1].events = POLLIN | (gui_output_pending() > 0 ? POLLOUT : 0);
+        int ret = poll(poll_arr, 4, -1);
 
         if (ret <= 0)   // timer powinien nas budzić co UPDATE_NANOSECOND_INTERVAL
             syserr("poll or timer");
 
-        if (poll_arr[0].revents & POLLIN) {
-            for (int t = 0; t < MAX_CONSECUTIVE_SERVER_MSG; t++) {
-                // limit żeby gra była responsive na input gracza
-                std::cout << "WIADOMOŚĆ OD SERWERA\n";
-                ret = read(poll_arr[0].fd, buf.data(), buf.size());
-
-                if (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-                    std::cout << "BRAK" << std::endl;
-                    // brak komunikatów do odebrania więc zerujemy revents
-                    poll_arr[0].revents = 0;
-                    break;
-                }
-
-                char *event_buf = (char *)buf.data();
-                while (ret > 0) {
-                    std::cout << "ret: " << ret << std::endl;
-                    uint32_t sent_game_id = be32toh(*(uint32_t *) event_buf);
-                    uint32_t len = be32toh(*(uint32_t *) (event_buf + 4));
-                    uint32_t event_no = be32toh(*(uint32_t *) (event_buf + 8));
-                    uint8_t event_type = *(uint8_t *) (event_buf + 12);
-                    std::cout << "game id (sent, mine):" << sent_game_id << " " << current_game_id << std::endl;
-                    std::cout << "len, number, type: " << len << ", " << event_no << ", " << (int)event_type << std::endl;
-
-                    uint32_t sent_crc32 = be32toh(*(uint32_t *) (event_buf + len + 8));
-                    uint32_t my_crc32 = crc32buf(event_buf + 4, len + 4);
-
-                    std::cout << "crc32(sent, mine):" << sent_crc32 << " " << my_crc32 << std::endl;
-
-                    if (my_crc32 != sent_crc32)
-                        break;
-
-                    if (event_type == TYPE_NEW_GAME) {
-                        std::cout << "NEW GAME\n";
-                        handle_new_game(len, event_no, event_buf, msg_to_gui, player_map);
-                    }
-                    else if (event_type == TYPE_PLAYER_ELIMINATED) {
-                        std::cout << "PLAYER ELIMINATED\n";
-                        uint8_t player_number = *(uint8_t *) (event_buf + 13);
-                        if (player_number >= player_count) {
-                            std::cerr << "player number too big\n";
-                            exit(1);
-                        }
-                        msg_to_gui = "PLAYER_ELIMINATED " + player_map[player_number] + "\n";
-                    }
-                    else if (event_type == TYPE_GAME_OVER) {
-                        std::cout << "GAME OVER\n";
-                        // gdy wyślemy last_event_no do gui to będzie faktyczny koniec gry z naszego punktu widzenia
-                        last_event_no = event_no;
-                    }
-                    else if (event_type == TYPE_PIXEL) {
-                        std::cout << "PIXEL\n";
-                        handle_pixel(event_buf, msg_to_gui, player_map);
-                    }
-                    else {
-                        std::cout << "UNKNOWN, ignoring\n";
-                    }
-
-                    std::cout << msg_to_gui;
-                    if (event_no == expected_event_no) {
-                        std::cout << "EVENT == EXPECTED, SENDING\n";
-                        write(poll_arr[1].fd, msg_to_gui.data(), msg_to_gui.size());
-
-                        if (last_event_no != 0 && expected_event_no == last_event_no) {
-                            // wysłaliśmy właśnie ostatni event w tej rozgrywce
-                            expected_event_no = 0;
-                            last_event_no = 0;
-                            ready_messages.clear();
-                        }
-                        else {
-                            expected_event_no++;
-                            send_ready_messages(poll_arr[1].fd, ready_messages);
-                        }
-                    }
-                    else if (event_no > expected_event_no && ready_messages.find(event_no) == ready_messages.end()) {
-                        ready_messages.insert(std::pair(event_no, msg_to_gui));
-                    }
-
-                    event_buf += (12 + len);
-                    ret -= (12 + (int)len);
-                }
-            }
-        }
+        if (poll_arr[0].revents & POLLIN)
+            receive_events(poll_arr[0]);
+        if (poll_arr[3].revents & POLLIN)
+            receive_events(poll_arr[3]);
 
         if (poll_arr[1].revents & POLLIN) {
-            std::cout << "WIADOMOŚĆ OD GUI\n";
             for (int t = 0; t < MAX_CONSECUTIVE_GUI_MSG; t++) {
                 // limit żeby gui nas nie sparaliżowało
                 ret = read(poll_arr[1].fd, command_buf, sizeof(command_buf) - 1);
 
                 if (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-                    std::cout << "BRAK" << std::endl;
                     // brak komunikatów do odebrania więc zerujemy revents
                     poll_arr[1].revents = 0;
                     break;
@@ -409,7 +447,7 @@ int main(int argc, char *argv[]) {
                 while (ret > 0) {
                     std::string command = my_getline(command_buf_str, command_buf);
 
-                    std::cout << ret << " " << command << std::endl;
+                    LOG_DEBUG("gui command %s", command.c_str());
 
                     if (command.empty() || command == "bad command")
                         break;
@@ -435,18 +473,18 @@ int main(int argc, char *argv[]) {
 
         if (poll_arr[2].revents & POLLIN) {
             poll_arr[2].revents = 0;
-            //std::cout << "timer up, sending to server\n";
             uint64_t exp;
             ret = read(poll_arr[2].fd, &exp, sizeof(uint64_t));
             if (ret != sizeof(uint64_t))
                 syserr("timer");
 
-            msg_to_server = {htobe64(session_id), turn_direction, htobe32(expected_event_no), 0};
-            for (int i = 0; i < player_name.size(); i++)
-                msg_to_server.player_name[i] = player_name[i];
-
-            write(server_sock, (char *)&msg_to_server, 13 + player_name.size());
+            msg_len = client_msg_encode(msg_to_server, session_id, turn_direction | capabilities,
+                                        requested_event_no(), player_name);
+            write(server_sock, (char *)&msg_to_server, msg_len);
         }
+
+        // wszystko z tego obrotu naraz, także gdy poll zgłosił tylko POLLOUT
+        gui_output_flush();
     }
 #pragma clang diagnostic pop
     return 0;
@@ -3,7 +3,16 @@
 #include <cstdarg>
 #include <cerrno>
 #include <cstring>
+#include <endian.h>
+#include <atomic>
+#include <string>
+#include <stdexcept>
 #include "common.h"
+#include "log.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 const uint32_t crc32_tab[] = {
         0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f,
@@ -56,6 +65,7 @@ void syserr(const char *fmt, ...)
     va_list fmt_args;
     int err = errno;
 
+    log_flush();
     fprintf(stderr, "ERROR: ");
 
     va_start(fmt_args, fmt);
@@ -65,7 +75,236 @@ void syserr(const char *fmt, ...)
     exit(EXIT_FAILURE);
 }
 
+/* crc32 - wielomian 0xEDB88320 (odwrócona reprezentacja), taki sam jak w zlib.
+ * Jądra operują na "surowym" rejestrze crc, bez początkowej i końcowej negacji. */
+namespace {
+    constexpr uint32_t CRC32_POLY = 0xedb88320;
+
+    typedef uint32_t (*crc32_kernel_t)(uint32_t crc, const uint8_t *p, size_t size);
+
+    struct crc32_slice8_tables {
+        uint32_t t[8][256];
+    };
+
+    constexpr crc32_slice8_tables make_slice8_tables() {
+        crc32_slice8_tables tables{};
+        for (uint32_t i = 0; i < 256; i++)
+            tables.t[0][i] = crc32_tab[i];
+        for (int k = 1; k < 8; k++)
+            for (uint32_t i = 0; i < 256; i++)
+                tables.t[k][i] = (tables.t[k - 1][i] >> 8) ^ tables.t[0][tables.t[k - 1][i] & 0xFF];
+        return tables;
+    }
+
+    constexpr crc32_slice8_tables slice8 = make_slice8_tables();
+
+    uint32_t crc32_kernel_bytewise(uint32_t crc, const uint8_t *p, size_t size) {
+        while (size--)
+            crc = crc32_tab[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+        return crc;
+    }
+
+    uint32_t crc32_kernel_slice8(uint32_t crc, const uint8_t *p, size_t size) {
+        const auto &t = slice8.t;
+        while (size >= 8) {
+            uint32_t one, two;
+            memcpy(&one, p, sizeof(one));
+            memcpy(&two, p + 4, sizeof(two));
+            one = le32toh(one) ^ crc;
+            two = le32toh(two);
+            crc = t[7][one & 0xFF] ^ t[6][(one >> 8) & 0xFF] ^
+                  t[5][(one >> 16) & 0xFF] ^ t[4][one >> 24] ^
+                  t[3][two & 0xFF] ^ t[2][(two >> 8) & 0xFF] ^
+                  t[1][(two >> 16) & 0xFF] ^ t[0][two >> 24];
+            p += 8;
+            size -= 8;
+        }
+        return crc32_kernel_bytewise(crc, p, size);
+    }
+
+#if defined(__x86_64__)
+    /* Zwijanie z mnożeniem bez przeniesień (PCLMULQDQ), wg "Fast CRC Computation for
+     * Generic Polynomials Using PCLMULQDQ Instruction" (Intel, 2009), stałe dla
+     * odwróconego wielomianu crc32. Bloki po 64 bajty, reszta przez slicing-by-8. */
+    __attribute__((target("pclmul,sse4.1")))
+    uint32_t crc32_kernel_clmul(uint32_t crc, const uint8_t *p, size_t size) {
+        if (size < 64)
+            return crc32_kernel_slice8(crc, p, size);
+
+        alignas(16) static const uint64_t k1k2[] = {0x0154442bd4, 0x01c6e41596};
+        alignas(16) static const uint64_t k3k4[] = {0x01751997d0, 0x00ccaa009e};
+        alignas(16) static const uint64_t k5k0[] = {0x0163cd6124, 0x0000000000};
+        alignas(16) static const uint64_t poly[] = {0x01db710641, 0x01f7011641};
+
+        size_t rest = size & 15;
+        size -= rest;
+
+        __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+        x1 = _mm_loadu_si128((const __m128i *) (p + 0x00));
+        x2 = _mm_loadu_si128((const __m128i *) (p + 0x10));
+        x3 = _mm_loadu_si128((const __m128i *) (p + 0x20));
+        x4 = _mm_loadu_si128((const __m128i *) (p + 0x30));
+        x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int) crc));
+        x0 = _mm_load_si128((const __m128i *) k1k2);
+        p += 64;
+        size -= 64;
+
+        // równoległe zwijanie bloków po 64 bajty
+        while (size >= 64) {
+            x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+            x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+            x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+            x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+            x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+            x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+            x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+            x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+            y5 = _mm_loadu_si128((const __m128i *) (p + 0x00));
+            y6 = _mm_loadu_si128((const __m128i *) (p + 0x10));
+            y7 = _mm_loadu_si128((const __m128i *) (p + 0x20));
+            y8 = _mm_loadu_si128((const __m128i *) (p + 0x30));
+
+            x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+            x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+            x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+            x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+
+            p += 64;
+            size -= 64;
+        }
+
+        // zwijanie do 128 bitów
+        x0 = _mm_load_si128((const __m128i *) k3k4);
+
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+        // pojedyncze bloki po 16 bajtów
+        while (size >= 16) {
+            x2 = _mm_loadu_si128((const __m128i *) p);
+
+            x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+            x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+            x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+            p += 16;
+            size -= 16;
+        }
+
+        // zwijanie 128 -> 64 bity
+        x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+        x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+        x1 = _mm_srli_si128(x1, 8);
+        x1 = _mm_xor_si128(x1, x2);
+
+        x0 = _mm_loadl_epi64((const __m128i *) k5k0);
+
+        x2 = _mm_srli_si128(x1, 4);
+        x1 = _mm_and_si128(x1, x3);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_xor_si128(x1, x2);
+
+        // redukcja Barretta do 32 bitów
+        x0 = _mm_load_si128((const __m128i *) poly);
+
+        x2 = _mm_and_si128(x1, x3);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+        x2 = _mm_and_si128(x2, x3);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x1 = _mm_xor_si128(x1, x2);
+
+        crc = (uint32_t) _mm_extract_epi32(x1, 1);
+        return crc32_kernel_slice8(crc, p, rest);
+    }
+#endif
+
+    uint32_t crc32_kernel_resolve(uint32_t crc, const uint8_t *p, size_t size);
+
+    /* wybierane przy pierwszym wywołaniu, więc działa też w inicjalizacji
+     * zmiennych globalnych innych jednostek kompilacji; atomowe, bo pierwsze
+     * wywołanie może się zdarzyć równocześnie w kilku wątkach serwera */
+    std::atomic<crc32_kernel_t> crc32_kernel{crc32_kernel_resolve};
+
+    uint32_t crc32_kernel_resolve(uint32_t crc, const uint8_t *p, size_t size) {
+        crc32_kernel_t kernel = crc32_kernel_slice8;
+#if defined(__x86_64__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1"))
+            kernel = crc32_kernel_clmul;
+#endif
+        crc32_kernel.store(kernel, std::memory_order_relaxed);
+        return kernel(crc, p, size);
+    }
+
+    /* a * b modulo wielomian crc, w odwróconej reprezentacji (jak w zlib) */
+    constexpr uint32_t multmodp(uint32_t a, uint32_t b) {
+        uint32_t m = 1U << 31;
+        uint32_t prod = 0;
+        while (m != 0) {
+            if (a & m) {
+                prod ^= b;
+                if ((a & (m - 1)) == 0)
+                    break;
+            }
+            m >>= 1;
+            b = (b & 1) ? (b >> 1) ^ CRC32_POLY : b >> 1;
+        }
+        return prod;
+    }
+
+    struct crc32_x2n_table {
+        uint32_t t[32];
+    };
+
+    constexpr crc32_x2n_table make_x2n_table() {
+        crc32_x2n_table table{};
+        uint32_t p = 1U << 30;  // x^1
+        table.t[0] = p;
+        for (int n = 1; n < 32; n++)
+            table.t[n] = p = multmodp(p, p);
+        return table;
+    }
+
+    constexpr crc32_x2n_table x2n = make_x2n_table();
+
+    /* x^(n * 2^k) modulo wielomian crc */
+    uint32_t x2nmodp(size_t n, unsigned k) {
+        uint32_t p = 1U << 31;  // x^0
+        while (n) {
+            if (n & 1)
+                p = multmodp(x2n.t[k & 31], p);
+            n >>= 1;
+            k++;
+        }
+        return p;
+    }
+}
+
 uint32_t crc32buf(const void *buf, size_t size) {
+    return crc32_update(0, buf, size);
+}
+
+uint32_t crc32_update(uint32_t crc, const void *buf, size_t size) {
+    return ~crc32_kernel.load(std::memory_order_relaxed)(~crc, static_cast<const uint8_t *>(buf), size);
+}
+
+uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, size_t size2) {
+    return multmodp(x2nmodp(size2, 3), crc1) ^ crc2;
+}
+
+uint32_t crc32_reference(const void *buf, size_t size) {
     const uint8_t *p = static_cast<const uint8_t *>(buf);
     uint32_t crc;
 
@@ -75,11 +314,33 @@ uint32_t crc32buf(const void *buf, size_t size) {
     return crc ^ ~0U;
 }
 
+uint32_t crc32_slice8(const void *buf, size_t size) {
+    return ~crc32_kernel_slice8(~0U, static_cast<const uint8_t *>(buf), size);
+}
+
+bool crc32_clmul_supported() {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+#else
+    return false;
+#endif
+}
+
+uint32_t crc32_clmul(const void *buf, size_t size) {
+#if defined(__x86_64__)
+    if (crc32_clmul_supported())
+        return ~crc32_kernel_clmul(~0U, static_cast<const uint8_t *>(buf), size);
+#endif
+    return crc32_slice8(buf, size);
+}
+
 
 void fatal(const char *fmt, ...)
 {
     va_list fmt_args;
 
+    log_flush();
     fprintf(stderr, "ERROR: ");
 
     va_start(fmt_args, fmt);
@@ -126,4 +387,22 @@ void create_timer(int &fd, int timer_type, int rounds_per_sec) {
 
     if (timerfd_settime(fd, TFD_TIMER_ABSTIME, &new_value, NULL) == -1)
         syserr("timerfd_settime create");
-}
\ No newline at end of file
+}
+
+int parse_number(const char *optarg, int min, int max, const char *what) {
+    try {
+        std::string arg = optarg;
+        std::size_t pos;
+        int value = std::stoi(arg, &pos);
+        if (pos < arg.size())
+            fatal("Trailing characters after number argument");
+        if (value < min || value > max)
+            fatal("invalid %s argument", what);
+        return value;
+    } catch (std::invalid_argument const &ex) {
+        fatal("Invalid number argument");
+    } catch (std::out_of_range const &ex) {
+        fatal("Number argument out of range");
+    }
+    return 0;
+}
@@ -2,16 +2,24 @@
 #define SIK2_COMMON_H
 
 #include <cstdint>
+#include <cstddef>
 #include <sys/timerfd.h>
 #define NOT_EATEN false
 #define EATEN true
 #define TURN_RIGHT 1
 #define TURN_LEFT 2
+#define CLIENT_CAP_KEYFRAME 0x80    // bit w turn_direction: klient rozumie TYPE_KEYFRAME
+#define CLIENT_CAP_MULTICAST 0x40   // bit w turn_direction: klient dostaje eventy na żywo z grupy multicast
+#define CLIENT_CAPS (CLIENT_CAP_KEYFRAME | CLIENT_CAP_MULTICAST)
+/* bit w next_expected_event_no (tylko z CLIENT_CAP_KEYFRAME): prośba o fragmenty klatki
+ * od numeru w młodszych bitach zamiast o eventy od 1, które klatka obejmuje */
+#define KEYFRAME_REQUEST 0x80000000u
 
 #define TYPE_NEW_GAME 0
 #define TYPE_PIXEL 1
 #define TYPE_PLAYER_ELIMINATED 2
 #define TYPE_GAME_OVER 3
+#define TYPE_KEYFRAME 4
 
 #define BOARD_HEIGHT_MAX 4096
 #define BOARD_WIDTH_MAX 4096
@@ -23,6 +31,7 @@
 #define MAX_NAME_LEN 20
 
 #define DEFAULT_SERVER_PORT 2021
+#define DEFAULT_MULTICAST_PORT 2221     // port grupy dla pokoju 0, pokój i używa portu o i większego
 
 #define DATAGRAM_MAX_SIZE 550
 #define CLIENT_TIMEOUT_SECONDS 2
@@ -43,8 +52,29 @@ extern void fatal(const char *fmt, ...);
 
 void create_timer(int &fd, int timer_type, int rounds_per_sec);
 
+/* liczba z argumentu z przedziału [min, max]; błędny argument kończy program przez fatal */
+int parse_number(const char *optarg, int min, int max, const char *what);
+
+/* crc32 (ten sam wielomian co w zlib); wybiera przy pierwszym użyciu najszybszą
+ * implementację dostępną na danym procesorze */
 uint32_t crc32buf(const void *buf, size_t size);
 
+/* Kontynuuje liczenie crc: crc32_update(crc32buf(a), b) == crc32buf(a + b),
+ * crc32_update(0, buf, size) == crc32buf(buf, size). */
+uint32_t crc32_update(uint32_t crc, const void *buf, size_t size);
+
+/* crc konkatenacji a + b na podstawie crc32buf(a), crc32buf(b) i długości b */
+uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, size_t size2);
+
+/* Konkretne implementacje, wszystkie dają ten sam wynik co crc32buf:
+ * referencyjna (bajt po bajcie), slicing-by-8 oraz PCLMULQDQ (x86-64; jeśli
+ * procesor jej nie wspiera, crc32_clmul liczy slicing-by-8). bench sprawdza ich zgodność
+ * z crc32_reference i mierzy każdą z osobna. */
+uint32_t crc32_reference(const void *buf, size_t size);
+uint32_t crc32_slice8(const void *buf, size_t size);
+uint32_t crc32_clmul(const void *buf, size_t size);
+bool crc32_clmul_supported();
+
 struct __attribute__((__packed__)) client_msg {
     uint64_t session_id;
     uint8_t turn_direction;
@@ -96,4 +126,20 @@ struct __attribute__((__packed__)) event_game_over {
     uint32_t crc32;
 };
 
+/* Fragment klatki planszy. event_no to pierwszy event, którego klatka nie obejmuje (obejmuje
+ * [1, event_no)). Za nagłówkiem: eliminated_count numerów wyeliminowanych graczy (tylko we
+ * fragmencie 0), potem przebiegi od komórki start_cell (y * maxx + x): varint liczba pustych
+ * komórek, bajt numeru gracza, varint liczba jego kolejnych komórek; na końcu crc32. */
+struct __attribute__((__packed__)) event_keyframe {
+    uint32_t game_id;
+    uint32_t len;
+    uint32_t event_no;
+    uint8_t event_type;
+
+    uint16_t fragment_no;
+    uint16_t fragment_count;
+    uint32_t start_cell;
+    uint8_t eliminated_count;
+};
+
 #endif //SIK2_COMMON_H
@@ -0,0 +1,48 @@
+#include <cstring>
+#include "common.h"
+#include "event_log.h"
+
+void event_log_append(event_log_t &log, const void *event, size_t size) {
+    uint32_t event_no = event_log_count(log);
+    const char *p = static_cast<const char *>(event);
+    log.data.insert(log.data.end(), p, p + size);
+    log.offsets.push_back((uint32_t) log.data.size());
+
+    if (log.datagram_starts.empty() ||
+        event_log_bytes(log, log.datagram_starts.back(), event_no + 1) > DATAGRAM_MAX_SIZE)
+        log.datagram_starts.push_back(event_no);  // nie zmieścił się w bieżącym datagramie
+    log.datagram_of.push_back((uint32_t) log.datagram_starts.size() - 1);
+}
+
+void event_log_clear(event_log_t &log) {
+    log.data.clear();
+    log.offsets.resize(1);
+    log.datagram_starts.clear();
+    log.datagram_of.clear();
+}
+
+uint32_t event_log_datagram_end(const event_log_t &log, uint32_t first) {
+    uint32_t count = event_log_count(log);
+    uint32_t limit = log.offsets[first] + DATAGRAM_MAX_SIZE;
+    uint32_t last = first + 1;  // pojedynczy event zawsze mieści się w datagramie
+    while (last < count && log.offsets[last + 1] <= limit)
+        last++;
+    return last;
+}
+
+size_t event_log_history(const event_log_t &log, uint32_t first, std::vector<iovec> &iovs,
+                         size_t max_datagrams) {
+    iovs.clear();
+    uint32_t count = event_log_count(log);
+    if (first >= count)
+        return 0;
+
+    size_t datagram = log.datagram_of[first];
+    while (iovs.size() < max_datagrams && first < count) {
+        datagram++;
+        uint32_t last = datagram < log.datagram_starts.size() ? log.datagram_starts[datagram] : count;
+        iovs.push_back({(void *) event_log_at(log, first), event_log_bytes(log, first, last)});
+        first = last;
+    }
+    return iovs.size();
+}
@@ -0,0 +1,52 @@
+#ifndef SIK2_EVENT_LOG_H
+#define SIK2_EVENT_LOG_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <sys/uio.h>
+
+/* Eventy jednej rozgrywki zapisane jeden za drugim dokładnie w postaci, w jakiej
+ * idą przez sieć (razem z game_id i crc), plus indeks początków po event_no.
+ * Dowolny przedział eventów to ciągły kawałek pamięci, który można wysłać bez
+ * kopiowania.
+ *
+ * Przy dopisywaniu log od razu dzieli się zachłannie na datagramy historii
+ * (indeks datagramów), więc wysłanie historii od dowolnego event_no to odczyt
+ * datagram_of[event_no] i wysłanie gotowych kawałków - pierwszy to sufiks
+ * datagramu zawierającego event_no, kolejne to całe datagramy. */
+struct event_log_t {
+    std::vector<char> data;
+    std::vector<uint32_t> offsets{0};       // event i zajmuje data[offsets[i], offsets[i + 1])
+    std::vector<uint32_t> datagram_starts;  // event_no pierwszego eventu każdego datagramu historii
+    std::vector<uint32_t> datagram_of;      // numer datagramu historii zawierającego dany event
+};
+
+inline uint32_t event_log_count(const event_log_t &log) {
+    return (uint32_t) log.offsets.size() - 1;
+}
+
+inline const char *event_log_at(const event_log_t &log, uint32_t event_no) {
+    return log.data.data() + log.offsets[event_no];
+}
+
+/* rozmiar w bajtach eventów [first, last) */
+inline size_t event_log_bytes(const event_log_t &log, uint32_t first, uint32_t last) {
+    return log.offsets[last] - log.offsets[first];
+}
+
+void event_log_append(event_log_t &log, const void *event, size_t size);
+
+/* czyści log, zostawiając zaalokowaną pamięć na kolejną rozgrywkę */
+void event_log_clear(event_log_t &log);
+
+/* Zwraca koniec (wyłącznie) najdłuższego ciągu eventów zaczynającego się od first,
+ * który mieści się w jednym datagramie; first < event_log_count(log). */
+uint32_t event_log_datagram_end(const event_log_t &log, uint32_t first);
+
+/* Wpisuje do iovs (czyszcząc je wcześniej) co najwyżej max_datagrams gotowych datagramów
+ * historii od eventu first do końca logu; zwraca ich liczbę. */
+size_t event_log_history(const event_log_t &log, uint32_t first, std::vector<iovec> &iovs,
+                         size_t max_datagrams);
+
+#endif //SIK2_EVENT_LOG_H
@@ -0,0 +1,198 @@
+#include <cstring>
+#include <charconv>
+#include <string_view>
+#include <endian.h>
+#include "common.h"
+#include "gui.h"
+
+namespace {
+    uint64_t get_varint(const char *&pos, const char *end) {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64 && pos < end; shift += 7) {
+            uint8_t c = *pos++;
+            value |= (uint64_t) (c & 0x7f) << shift;
+            if (!(c & 0x80))
+                return value;
+        }
+        fatal("truncated keyframe run");
+        return 0;
+    }
+
+    inline void append_number(std::string &out, uint64_t value) {
+        char buf[20];
+        char *end = std::to_chars(buf, buf + sizeof(buf), value).ptr;
+        out.append(buf, end - buf);
+    }
+
+    inline void append_pixel(std::string &out, uint64_t x, uint64_t y, const std::string &name_suffix) {
+        out.append("PIXEL ");
+        append_number(out, x);
+        out += ' ';
+        append_number(out, y);
+        out.append(name_suffix);
+    }
+}
+
+void gui_new_game(gui_game_t &game, const event_view_t &event, std::string &out) {
+    if (event.event_no != 0) {
+        fatal("new game with nonzero event_no");
+    }
+
+    const char *event_buf = event.data;
+    uint32_t len = event.len;
+    game.maxx = be32toh(*(uint32_t *) (event_buf + 13));
+    game.maxy = be32toh(*(uint32_t *) (event_buf + 17));
+
+    if (game.maxx > BOARD_WIDTH_MAX || game.maxy > BOARD_HEIGHT_MAX) {
+        fatal("board too large");
+    }
+    // lista nazw to len - 13 bajtów, każda nazwa zakończona \0
+    const char *player_names = event_buf + 21;
+    if (len < 14 || player_names[len - 14] != '\0') {
+        fatal("player name list not null terminated");
+    }
+
+    out.append("NEW_GAME ");
+    append_number(out, game.maxx);
+    out += ' ';
+    append_number(out, game.maxy);
+
+    game.player_count = 0;      // numery graczy dotyczą tylko tej gry
+    game.keyframe_event_no = 0;
+    game.keyframe_fragments.clear();
+    game.keyframe_next = 0;
+    game.keyframe_lines.clear();
+    uint32_t name_start = 0;
+    for (uint32_t i = 0; i < len - 13; i++) {
+        char c = player_names[i];
+        if (c != '\0') {
+            if (c < 33 || c > 126) {
+                fatal("invalid char %d in player name list", (int) c);
+            }
+            continue;
+        }
+
+        std::string_view name(player_names + name_start, i - name_start);
+        if (game.player_count == game.name_suffixes.size())
+            game.name_suffixes.emplace_back();
+        std::string &name_suffix = game.name_suffixes[game.player_count++];
+        name_suffix.assign(1, ' ');
+        name_suffix.append(name);
+        name_suffix += '\n';
+
+        out += ' ';
+        out.append(name);
+        name_start = i + 1;
+    }
+    out += '\n';
+}
+
+void gui_event_decode(const event_view_t &event, gui_event_t &decoded) {
+    decoded = {event.game_id, event.event_no, event.type, 0, 0, 0};
+    if (event.type == TYPE_PIXEL) {
+        if (event.len < sizeof(event_pixel) - 12)
+            fatal("pixel event too short");
+        decoded.player_number = *(uint8_t *) (event.data + 13);
+        decoded.x = be32toh(*(uint32_t *) (event.data + 14));
+        decoded.y = be32toh(*(uint32_t *) (event.data + 18));
+    } else if (event.type == TYPE_PLAYER_ELIMINATED) {
+        if (event.len < sizeof(event_player_eliminated) - 12)
+            fatal("player eliminated event too short");
+        decoded.player_number = *(uint8_t *) (event.data + 13);
+    }
+}
+
+void gui_event_format(const gui_game_t &game, const gui_event_t &event, std::string &out) {
+    if (event.type != TYPE_PIXEL && event.type != TYPE_PLAYER_ELIMINATED)
+        return;     // game_over i nieznane typy nie mają linii dla gui
+
+    if (event.player_number >= game.player_count) {
+        fatal("player number too big");
+    }
+    const std::string &name_suffix = game.name_suffixes[event.player_number];
+
+    if (event.type == TYPE_PLAYER_ELIMINATED) {
+        out.append("PLAYER_ELIMINATED");
+        out.append(name_suffix);
+        return;
+    }
+
+    if (event.x > game.maxx || event.y > game.maxy) {
+        fatal("pixel outside board");
+    }
+    append_pixel(out, event.x, event.y, name_suffix);
+}
+
+void gui_pixel(const gui_game_t &game, const event_view_t &event, std::string &out) {
+    gui_event_t decoded;
+    gui_event_decode(event, decoded);
+    gui_event_format(game, decoded, out);
+}
+
+void gui_player_eliminated(const gui_game_t &game, const event_view_t &event, std::string &out) {
+    gui_event_t decoded;
+    gui_event_decode(event, decoded);
+    gui_event_format(game, decoded, out);
+}
+
+bool gui_keyframe(gui_game_t &game, const event_view_t &event, std::string &out) {
+    if (event.len + 12 < sizeof(event_keyframe) + 4)
+        fatal("keyframe too short");
+    event_keyframe header;
+    memcpy(&header, event.data, sizeof(header));
+    uint16_t fragment_no = be16toh(header.fragment_no);
+    uint16_t fragment_count = be16toh(header.fragment_count);
+    if (fragment_no >= fragment_count)
+        fatal("invalid keyframe fragment number");
+
+    if (event.event_no < game.keyframe_event_no)
+        return false;
+    if (event.event_no > game.keyframe_event_no) {
+        game.keyframe_event_no = event.event_no;
+        game.keyframe_fragments.assign(fragment_count, false);
+        game.keyframe_missing = fragment_count;
+        game.keyframe_next = 0;
+        game.keyframe_lines.clear();
+    }
+    if (game.keyframe_fragments.size() != fragment_count || game.keyframe_fragments[fragment_no])
+        return false;
+    game.keyframe_fragments[fragment_no] = true;
+    while (game.keyframe_next < fragment_count && game.keyframe_fragments[game.keyframe_next])
+        game.keyframe_next++;
+    std::string &lines = game.keyframe_lines;
+
+    const char *pos = event.data + sizeof(header);
+    const char *end = event.data + event.len + 8;
+    if (header.eliminated_count > end - pos)
+        fatal("keyframe too short");
+    for (int i = 0; i < header.eliminated_count; i++) {
+        uint8_t player_number = *pos++;
+        if (player_number >= game.player_count)
+            fatal("player number too big");
+        lines.append("PLAYER_ELIMINATED");
+        lines.append(game.name_suffixes[player_number]);
+    }
+
+    uint64_t cell = be32toh(header.start_cell);
+    uint64_t cells = (uint64_t) game.maxx * game.maxy;
+    while (pos < end) {
+        cell += get_varint(pos, end);
+        if (pos == end)
+            fatal("truncated keyframe run");
+        uint8_t player_number = *pos++;
+        uint64_t length = get_varint(pos, end);
+        if (player_number >= game.player_count)
+            fatal("player number too big");
+        if (cell + length > cells)
+            fatal("pixel outside board");
+        const std::string &name_suffix = game.name_suffixes[player_number];
+        for (uint64_t last = cell + length; cell < last; cell++)
+            append_pixel(lines, cell % game.maxx, cell / game.maxx, name_suffix);
+    }
+
+    if (--game.keyframe_missing != 0)
+        return false;
+    out.append(lines);
+    lines.clear();
+    return true;
+}
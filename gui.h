@@ -0,0 +1,60 @@
+#ifndef SIK2_GUI_H
+#define SIK2_GUI_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "protocol.h"
+
+/* Tłumaczenie eventów od serwera na komunikaty tekstowe dla gui. Linie są dopisywane wprost
+ * do bufora wyjściowego (std::to_chars, gotowe kawałki z nazwami graczy), więc przy buforze
+ * o wystarczającej pojemności formatowanie nie alokuje pamięci. */
+
+/* stan bieżącej gry potrzebny do sprawdzania i formatowania kolejnych eventów */
+struct gui_game_t {
+    uint32_t maxx = 0;
+    uint32_t maxy = 0;
+    uint32_t player_count = 0;
+    /* " nazwa\n" gracza o danym numerze, renderowane raz przy new_game; ma player_count ważnych
+     * pozycji, dalsze zostają z poprzednich gier razem z pamięcią */
+    std::vector<std::string> name_suffixes;
+
+    uint32_t keyframe_event_no = 0;     // klatka, której fragmenty zbieramy, 0 - żadna
+    std::vector<bool> keyframe_fragments;
+    uint32_t keyframe_missing = 0;
+    uint32_t keyframe_next = 0;         // pierwszy brakujący fragment, od niego klient prosi o resztę
+    std::string keyframe_lines;         // linie odebranych fragmentów, do gui dopiero z całą klatką
+};
+
+/* Event z gry zdekodowany, ale jeszcze niesformatowany - tak czekają w oknie porządkującym
+ * klienta eventy, które wyprzedziły brakujący wcześniejszy. new_game i klatki są zawsze
+ * formatowane od razu. */
+struct gui_event_t {
+    uint32_t game_id;
+    uint32_t event_no;
+    uint8_t type;
+    uint8_t player_number;  // pixel i player_eliminated
+    uint32_t x;             // tylko pixel
+    uint32_t y;
+};
+
+void gui_event_decode(const event_view_t &event, gui_event_t &decoded);
+
+/* Każda funkcja dopisuje do out całe linie (z '\n'), a przy evencie niezgodnym
+ * z protokołem kończy program przez fatal. */
+
+/* linia dla pixel i player_eliminated, nic dla game_over i nieznanych typów */
+void gui_event_format(const gui_game_t &game, const gui_event_t &event, std::string &out);
+
+void gui_new_game(gui_game_t &game, const event_view_t &event, std::string &out);
+void gui_pixel(const gui_game_t &game, const event_view_t &event, std::string &out);
+void gui_player_eliminated(const gui_game_t &game, const event_view_t &event, std::string &out);
+
+/* Fragment klatki planszy (TYPE_KEYFRAME): linie PLAYER_ELIMINATED i PIXEL z fragmentu,
+ * którego jeszcze nie było, są zbierane w game, a gdy klatka się skompletuje, wszystkie
+ * naraz trafiają do out i funkcja zwraca true. Niepełna klatka nie wysyła więc do gui nic,
+ * co mogłoby się powtórzyć w historii. Fragmenty klatki starszej niż zbierana są pomijane,
+ * a nowsza (serwer zdążył ją przebudować) zaczyna zbieranie od nowa. */
+bool gui_keyframe(gui_game_t &game, const event_view_t &event, std::string &out);
+
+#endif //SIK2_GUI_H
@@ -0,0 +1,104 @@
+#include <cstring>
+#include <algorithm>
+#include <endian.h>
+#include "common.h"
+#include "keyframe.h"
+
+#define KEYFRAME_FRAGMENT_MAX DATAGRAM_MAX_SIZE    // cały fragment razem z nagłówkiem i crc
+#define KEYFRAME_FRAGMENTS_MAX UINT16_MAX           // event_keyframe::fragment_count ma 16 bitów
+
+namespace {
+    size_t put_varint(uint8_t *buf, uint64_t value) {
+        size_t size = 0;
+        do {
+            buf[size] = value & 0x7f;
+            value >>= 7;
+            if (value != 0)
+                buf[size] |= 0x80;
+            size++;
+        } while (value != 0);
+        return size;
+    }
+
+    struct fragment_t {
+        uint32_t start_cell;
+        std::vector<uint8_t> runs;
+    };
+
+    /* dzieli zajęte pola na przebiegi i pakuje je we fragmenty mieszczące się w datagramie */
+    std::vector<fragment_t> encode_runs(const keyframe_t &keyframe) {
+        std::vector<fragment_t> fragments(1, {0, {}});
+        size_t limit = KEYFRAME_FRAGMENT_MAX - sizeof(event_keyframe) - keyframe.eliminated.size() - 4;
+        uint64_t pos = 0;   // pierwsza komórka za ostatnim przebiegiem
+        const std::vector<uint64_t> &cells = keyframe.cells;
+
+        for (size_t i = 0; i < cells.size();) {
+            uint64_t start = cells[i] >> 8;
+            uint8_t owner = cells[i] & 0xff;
+            size_t end = i + 1;
+            while (end < cells.size() && (cells[end] >> 8) == start + (end - i) && (cells[end] & 0xff) == owner)
+                end++;
+
+            uint8_t run[21];
+            size_t size = put_varint(run, start - pos);
+            run[size++] = owner;
+            size += put_varint(run + size, end - i);
+
+            if (fragments.back().runs.size() + size > limit) {
+                fragments.push_back({(uint32_t) pos, {}});
+                limit = KEYFRAME_FRAGMENT_MAX - sizeof(event_keyframe) - 4;
+            }
+            fragments.back().runs.insert(fragments.back().runs.end(), run, run + size);
+            pos = start + (end - i);
+            i = end;
+        }
+        return fragments;
+    }
+}
+
+void keyframe_clear(keyframe_t &keyframe) {
+    keyframe.event_no = 0;
+    keyframe.wanted = false;
+    keyframe.cells.clear();
+    keyframe.eliminated.clear();
+    event_log_clear(keyframe.fragments);
+}
+
+void keyframe_update(keyframe_t &keyframe, const event_log_t &log, uint32_t game_id, uint32_t board_width) {
+    uint32_t count = event_log_count(log);
+    size_t old_cells = keyframe.cells.size();
+    for (uint32_t event_no = std::max<uint32_t>(keyframe.event_no, 1); event_no < count; event_no++) {
+        const char *event = event_log_at(log, event_no);
+        uint8_t type = *(uint8_t *) (event + 12);
+        uint8_t player_number = *(uint8_t *) (event + 13);
+        if (type == TYPE_PIXEL) {
+            uint64_t x = be32toh(*(uint32_t *) (event + 14));
+            uint64_t y = be32toh(*(uint32_t *) (event + 18));
+            keyframe.cells.push_back(((y * board_width + x) << 8) | player_number);
+        } else if (type == TYPE_PLAYER_ELIMINATED) {
+            keyframe.eliminated.push_back(player_number);
+        }
+    }
+    std::sort(keyframe.cells.begin() + old_cells, keyframe.cells.end());
+    std::inplace_merge(keyframe.cells.begin(), keyframe.cells.begin() + old_cells, keyframe.cells.end());
+    keyframe.event_no = count;
+
+    std::vector<fragment_t> fragments = encode_runs(keyframe);
+    event_log_clear(keyframe.fragments);
+    if (fragments.size() > KEYFRAME_FRAGMENTS_MAX)
+        return;     // bez fragmentów, klienci dostaną zwykłą historię
+    char buf[KEYFRAME_FRAGMENT_MAX];
+    for (size_t f = 0; f < fragments.size(); f++) {
+        size_t eliminated = f == 0 ? keyframe.eliminated.size() : 0;
+        size_t size = sizeof(event_keyframe) + eliminated + fragments[f].runs.size() + 4;
+        event_keyframe header{htobe32(game_id), htobe32((uint32_t) size - 12), htobe32(count), TYPE_KEYFRAME,
+                              htobe16((uint16_t) f), htobe16((uint16_t) fragments.size()),
+                              htobe32(fragments[f].start_cell), (uint8_t) eliminated};
+        memcpy(buf, &header, sizeof(header));
+        memcpy(buf + sizeof(header), keyframe.eliminated.data(), eliminated);
+        memcpy(buf + sizeof(header) + eliminated, fragments[f].runs.data(), fragments[f].runs.size());
+        uint32_t crc32 = htobe32(crc32buf(buf + 4, size - 8));
+        memcpy(buf + size - 4, &crc32, sizeof(crc32));
+        event_log_append(keyframe.fragments, buf, size);
+    }
+}
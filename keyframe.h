@@ -0,0 +1,30 @@
+#ifndef SIK2_KEYFRAME_H
+#define SIK2_KEYFRAME_H
+
+#include <cstdint>
+#include <vector>
+#include "event_log.h"
+
+#define KEYFRAME_INTERVAL 1024      // nowa klatka, gdy log urósł o tyle eventów od poprzedniej
+
+/* Klatka planszy bieżącej gry: zamiast całej historii od eventu 1 dołączający klient dostaje
+ * new_game, fragmenty klatki (TYPE_KEYFRAME, opis formatu w common.h) i ogon logu od
+ * event_no. Klatka jest budowana przyrostowo z logu, więc kolejne aktualizacje kosztują tyle,
+ * ile nowych eventów i zajętych pól, a nie rozmiar planszy. */
+struct keyframe_t {
+    uint32_t event_no = 0;          // klatka obejmuje eventy [1, event_no), 0 - brak klatki
+    std::vector<uint64_t> cells;    // (komórka << 8) | numer gracza, posortowane po komórce
+    std::vector<uint8_t> eliminated;
+    event_log_t fragments;          // fragmenty w postaci gotowej do wysłania
+    /* Klient prosił o klatkę, a brak jej albo jest przestarzała. Fragmenty mogą być jeszcze
+     * wysyłane (room_send_t), więc przebudowa czeka do następnej tury pokoju. */
+    bool wanted = false;
+};
+
+void keyframe_clear(keyframe_t &keyframe);
+
+/* Dokłada do klatki eventy [keyframe.event_no, koniec logu) i koduje ją od nowa. Jeśli
+ * zakodowana klatka nie mieści się w UINT16_MAX fragmentach, fragments zostaje puste. */
+void keyframe_update(keyframe_t &keyframe, const event_log_t &log, uint32_t game_id, uint32_t board_width);
+
+#endif //SIK2_KEYFRAME_H
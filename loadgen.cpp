@@ -0,0 +1,429 @@
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <getopt.h>
+#include <cstring>
+#include <cerrno>
+#include <netdb.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <memory>
+#include <random>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include "common.h"
+#include "metrics.h"
+#include "protocol.h"
+
+/* Generator obciążenia: wielu botów (graczy i obserwatorów) w jednym procesie, każdy z własnym
+ * gniazdem UDP, mówiących tym samym protokołem co klient, ale bez gui. Na koniec wypisuje
+ * statystyki w postaci linii "nazwa wartość". */
+
+#define DEFAULT_PLAYERS 2
+#define DEFAULT_OBSERVERS 0
+#define DEFAULT_SECONDS 10
+#define BOTS_MAX 4096
+#define MAX_CONSECUTIVE_SERVER_MSG 64   // na jedno gniazdo, żeby nie zagłodzić pozostałych
+#define EPOLL_EVENTS_MAX 256
+#define EPOLL_SEND_TIMER UINT32_MAX     // data.u32 timera, gniazda mają indeks bota
+#define RANDOM_TURN_CHANGE 8            // tryb random zmienia kierunek średnio co tyle komunikatów
+#define LATENCY_PROBE_INTERVAL 16       // co tyle komunikatów bot mierzy opóźnienie odpowiedzi serwera
+#define OLD_GAMES_MAX 4                 // zakończone gry bota, których spóźnione eventy są pomijane
+
+namespace {
+    enum input_pattern_t {
+        INPUT_RANDOM,   // losowe skręty
+        INPUT_LEFT,     // ciągle w lewo
+        INPUT_IDLE,     // skręt tylko poza grą, żeby zgłosić gotowość, w grze prosto
+    };
+
+    struct bot_t {
+        int socket;
+        int room;
+        uint64_t session_id;
+        std::string name;               // pusta - obserwator
+        uint8_t turn_direction = 0;
+        uint32_t game_id = 0;
+        bool has_game = false;
+        uint32_t expected_event_no = 0;
+        uint32_t last_event_no = 0;     // numer game_over bieżącej gry, 0 - jeszcze nie dotarł
+        std::vector<char> seen;         // eventy bieżącej gry, które już dotarły
+        uint32_t old_game_ids[OLD_GAMES_MAX] = {};
+        uint32_t old_game_count = 0;
+        uint64_t msgs_sent = 0;
+        /* Pomiar opóźnienia: co LATENCY_PROBE_INTERVAL komunikatów bot prosi o ostatni event,
+         * który już ma, a serwer odsyła historię od razu przy obsłudze komunikatu. */
+        uint32_t probe_event_no = 0;
+        uint64_t probe_sent_ns = 0;     // 0 - brak pomiaru w toku
+    };
+
+    struct stats_t {
+        uint64_t datagrams = 0;
+        uint64_t bytes = 0;
+        uint64_t events = 0;
+        uint64_t new_events = 0;
+        uint64_t gap_events = 0;        // nowe eventy, które wyprzedziły brakujący wcześniejszy
+        uint64_t duplicate_events = 0;  // eventy otrzymane ponownie, zwykle z historii
+        uint64_t duplicate_bytes = 0;
+        uint64_t bad_datagrams = 0;     // ucięte albo ze złym crc
+        uint64_t games = 0;
+        uint64_t msgs_sent = 0;
+        uint64_t stale_events = 0;      // spóźnione eventy wcześniejszych gier bota
+        uint64_t probes = 0;
+        uint64_t probe_replies = 0;
+        metric_histogram_t latency_ns;      // od wysłania komunikatu do odebrania eventu, o który prosił
+        metric_histogram_t fanout_skew_ns;  // od odebrania eventu przez pierwszego bota pokoju
+    };
+
+    char *server;
+    int port = DEFAULT_SERVER_PORT;
+    int room_count = 1;
+    int player_count = DEFAULT_PLAYERS;
+    int observer_count = DEFAULT_OBSERVERS;
+    int seconds = DEFAULT_SECONDS;
+    input_pattern_t input_pattern = INPUT_RANDOM;
+    uint64_t seed = 1;
+
+    std::vector<bot_t> bots;
+    /* pierwsza chwila, w której dowolny bot pokoju dostał dany event: pokój -> game_id -> event_no;
+     * tylko do rozrzutu między odbiorcami, opóźnienie mierzą sondy botów */
+    std::vector<std::unordered_map<uint32_t, std::vector<uint64_t>>> first_seen;
+    std::unique_ptr<stats_t> stats;
+
+    void get_args(int argc, char *argv[]) {
+        int opt;
+        while ((opt = getopt(argc, argv, "p:r:n:o:i:d:s:")) != -1) {
+            switch (opt) {
+                case 'p':
+                    port = parse_number(optarg, 2, 65535, "port");
+                    break;
+                case 'r':
+                    room_count = parse_number(optarg, 1, 1024, "room count");
+                    break;
+                case 'n':
+                    player_count = parse_number(optarg, 0, BOTS_MAX, "player count");
+                    break;
+                case 'o':
+                    observer_count = parse_number(optarg, 0, BOTS_MAX, "observer count");
+                    break;
+                case 'd':
+                    seconds = parse_number(optarg, 1, 86400, "duration");
+                    break;
+                case 's':
+                    seed = parse_number(optarg, 0, INT32_MAX, "seed");
+                    break;
+                case 'i':
+                    if (strcmp(optarg, "random") == 0)
+                        input_pattern = INPUT_RANDOM;
+                    else if (strcmp(optarg, "left") == 0)
+                        input_pattern = INPUT_LEFT;
+                    else if (strcmp(optarg, "idle") == 0)
+                        input_pattern = INPUT_IDLE;
+                    else
+                        fatal("invalid input pattern argument (random, left or idle)");
+                    break;
+                default:
+                    fatal("Arguments: game_server [-p n] [-r n] [-n n] [-o n] [-i random|left|idle] [-d n] [-s n]\n");
+            }
+        }
+        if (argc - optind != 0)
+            fatal("Arguments: game_server [-p n] [-r n] [-n n] [-o n] [-i random|left|idle] [-d n] [-s n]\n");
+
+        if (port + room_count - 1 > 65535)
+            fatal("too many rooms for the given port");
+        if ((player_count + room_count - 1) / room_count > MAX_PLAYERS)
+            fatal("more than %d players per room", MAX_PLAYERS);
+        if (player_count + observer_count > BOTS_MAX)
+            fatal("too many bots");
+    }
+
+    int connect_bot_socket(int room) {
+        addrinfo addr_hints{};
+        addr_hints.ai_family = AF_UNSPEC;
+        addr_hints.ai_socktype = SOCK_DGRAM;
+        addr_hints.ai_protocol = IPPROTO_UDP;
+        addrinfo *addr_result;
+
+        std::string room_port = std::to_string(port + room);
+        if (getaddrinfo(server, room_port.c_str(), &addr_hints, &addr_result) != 0)
+            syserr("getaddrinfo server");
+
+        int sock = socket(addr_result->ai_family, addr_result->ai_socktype, addr_result->ai_protocol);
+        if (sock < 0)
+            syserr("socket server");
+        if (connect(sock, addr_result->ai_addr, addr_result->ai_addrlen))
+            syserr("connect server");
+        freeaddrinfo(addr_result);
+
+        if (fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK) == -1)
+            syserr("fcntl server");
+        return sock;
+    }
+
+    void init_bots() {
+        timeval tv{};
+        gettimeofday(&tv, NULL);
+        uint64_t first_session_id = 1000000 * tv.tv_sec + tv.tv_usec;
+
+        for (int i = 0; i < player_count + observer_count; i++) {
+            bot_t &bot = bots.emplace_back();
+            bool player = i < player_count;
+            bot.room = (player ? i : i - player_count) % room_count;
+            bot.socket = connect_bot_socket(bot.room);
+            bot.session_id = first_session_id + i;
+            if (player)
+                bot.name = "bot" + std::to_string(i);
+        }
+        first_seen.resize(room_count);
+    }
+
+    void update_turn_direction(bot_t &bot, std::mt19937_64 &rand) {
+        if (bot.name.empty())
+            return;
+
+        if (!bot.has_game || bot.last_event_no != 0) {
+            // poza grą tylko skręt zgłasza gotowość do następnej
+            bot.turn_direction = input_pattern == INPUT_LEFT ? TURN_LEFT : TURN_RIGHT;
+            return;
+        }
+
+        switch (input_pattern) {
+            case INPUT_RANDOM:
+                if (rand() % RANDOM_TURN_CHANGE == 0)
+                    bot.turn_direction = rand() % 3;
+                break;
+            case INPUT_LEFT:
+                bot.turn_direction = TURN_LEFT;
+                break;
+            case INPUT_IDLE:
+                bot.turn_direction = 0;
+                break;
+        }
+    }
+
+    void send_updates(std::mt19937_64 &rand) {
+        client_msg msg{};
+        for (size_t b = 0; b < bots.size(); b++) {
+            bot_t &bot = bots[b];
+            update_turn_direction(bot, rand);
+
+            // sondy botów rozłożone po kolejnych obrotach timera
+            uint32_t expected_event_no = bot.expected_event_no;
+            if ((bot.msgs_sent + b) % LATENCY_PROBE_INTERVAL == 0 && bot.has_game && bot.last_event_no == 0 &&
+                expected_event_no > 0) {
+                expected_event_no--;
+                bot.probe_event_no = expected_event_no;
+                bot.probe_sent_ns = metrics_now_ns();
+                stats->probes++;
+            }
+
+            size_t len = client_msg_encode(msg, bot.session_id, bot.turn_direction, expected_event_no, bot.name);
+            write(bot.socket, &msg, len);   // przy pełnym buforze po prostu gubimy, jak klient
+            bot.msgs_sent++;
+            stats->msgs_sent++;
+        }
+    }
+
+    bool is_old_game(const bot_t &bot, uint32_t game_id) {
+        uint32_t count = std::min<uint32_t>(bot.old_game_count, OLD_GAMES_MAX);
+        for (uint32_t i = 0; i < count; i++) {
+            if (bot.old_game_ids[i] == game_id)
+                return true;
+        }
+        return false;
+    }
+
+    void switch_game(bot_t &bot, uint32_t game_id) {
+        if (bot.has_game)
+            bot.old_game_ids[bot.old_game_count++ % OLD_GAMES_MAX] = bot.game_id;
+        bot.game_id = game_id;
+        bot.has_game = true;
+        bot.expected_event_no = 0;
+        bot.last_event_no = 0;
+        bot.seen.clear();
+        bot.probe_sent_ns = 0;
+    }
+
+    void handle_event(bot_t &bot, const event_view_t &event, uint64_t now) {
+        stats->events++;
+        if (!bot.has_game || event.game_id != bot.game_id) {
+            // game_id są losowe, więc "starsza gra" to jedna z ostatnich gier tego bota
+            if (bot.has_game && is_old_game(bot, event.game_id)) {
+                stats->stale_events++;
+                return;
+            }
+            switch_game(bot, event.game_id);
+        }
+
+        if (bot.probe_sent_ns != 0 && event.event_no == bot.probe_event_no) {
+            metric_record(stats->latency_ns, now - bot.probe_sent_ns);
+            bot.probe_sent_ns = 0;
+            if (event.event_no < bot.seen.size() && bot.seen[event.event_no]) {
+                stats->probe_replies++;     // odpowiedź na sondę to nie odzyskiwanie zgubionych eventów
+                return;
+            }
+        }
+
+        if (event.event_no < bot.seen.size() && bot.seen[event.event_no]) {
+            stats->duplicate_events++;
+            stats->duplicate_bytes += event.len + 12;
+            return;
+        }
+        if (event.event_no >= bot.seen.size())
+            bot.seen.resize(std::max<size_t>(event.event_no + 1, bot.seen.size() * 2), false);
+        bot.seen[event.event_no] = true;
+        stats->new_events++;
+        if (event.event_no > bot.expected_event_no)
+            stats->gap_events++;
+        if (event.type == TYPE_GAME_OVER)
+            bot.last_event_no = event.event_no;
+
+        std::vector<uint64_t> &room_first_seen = first_seen[bot.room][event.game_id];
+        if (room_first_seen.empty())
+            stats->games++;
+        if (event.event_no >= room_first_seen.size())
+            room_first_seen.resize(std::max<size_t>(event.event_no + 1, room_first_seen.size() * 2), 0);
+        if (room_first_seen[event.event_no] == 0)
+            room_first_seen[event.event_no] = now;
+        metric_record(stats->fanout_skew_ns, now - room_first_seen[event.event_no]);
+
+        while (bot.expected_event_no < bot.seen.size() && bot.seen[bot.expected_event_no]) {
+            if (bot.last_event_no != 0 && bot.expected_event_no == bot.last_event_no) {
+                bot.expected_event_no = 0;  // koniec gry, jak w kliencie
+                break;
+            }
+            bot.expected_event_no++;
+        }
+    }
+
+    void receive_events(bot_t &bot, char *buf) {
+        for (int t = 0; t < MAX_CONSECUTIVE_SERVER_MSG; t++) {
+            ssize_t ret = read(bot.socket, buf, DATAGRAM_MAX_SIZE);
+            if (ret < 0)
+                return;     // EAGAIN albo np. ICMP port unreachable z poprzedniego wysłania
+
+            uint64_t now = metrics_now_ns();
+            stats->datagrams++;
+            stats->bytes += ret;
+
+            const char *event_buf = buf;
+            while (ret > 0) {
+                event_view_t event{};
+                size_t event_size = event_parse(event_buf, ret, event);
+                if (event_size == 0) {
+                    stats->bad_datagrams++;
+                    break;
+                }
+                handle_event(bot, event, now);
+                event_buf += event_size;
+                ret -= (ssize_t) event_size;
+            }
+        }
+    }
+
+    void print_stat(const char *name, uint64_t value) {
+        printf("%s %lu\n", name, (unsigned long) value);
+    }
+
+    void print_percentiles(const std::string &name, const metric_histogram_t &histogram) {
+        static const struct {
+            const char *suffix;
+            double p;
+        } percentiles[] = {{"_p50", 0.5}, {"_p90", 0.9}, {"_p99", 0.99}, {"_p999", 0.999}};
+        for (auto &percentile : percentiles)
+            print_stat((name + percentile.suffix).c_str(), metric_percentile(histogram, percentile.p));
+        print_stat((name + "_max").c_str(), histogram.max.load(std::memory_order_relaxed));
+    }
+
+    void print_report(uint64_t elapsed_ns) {
+        double elapsed_s = (double) elapsed_ns / 1e9;
+        print_stat("bots_players", player_count);
+        print_stat("bots_observers", observer_count);
+        print_stat("elapsed_ms", elapsed_ns / 1000000);
+        print_stat("msgs_sent", stats->msgs_sent);
+        print_stat("datagrams_in", stats->datagrams);
+        print_stat("bytes_in", stats->bytes);
+        print_stat("datagrams_per_sec", (uint64_t) ((double) stats->datagrams / elapsed_s));
+        print_stat("bytes_per_sec", (uint64_t) ((double) stats->bytes / elapsed_s));
+        print_stat("events_in", stats->events);
+        print_stat("events_new", stats->new_events);
+        print_stat("events_new_per_sec", (uint64_t) ((double) stats->new_events / elapsed_s));
+        print_stat("events_gap", stats->gap_events);
+        printf("gap_rate %.6f\n", stats->new_events == 0 ? 0.0 :
+                                  (double) stats->gap_events / (double) stats->new_events);
+        print_stat("resent_events", stats->duplicate_events);
+        print_stat("resent_bytes", stats->duplicate_bytes);
+        print_stat("bad_datagrams", stats->bad_datagrams);
+        print_stat("stale_events", stats->stale_events);
+        print_stat("games", stats->games);
+        print_stat("latency_probes", stats->probes);
+        print_stat("latency_probe_replies", stats->probe_replies);
+        print_percentiles("latency_ns", stats->latency_ns);
+        print_percentiles("fanout_skew_ns", stats->fanout_skew_ns);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2)
+        fatal("Arguments: game_server [-p n] [-r n] [-n n] [-o n] [-i random|left|idle] [-d n] [-s n]\n");
+
+    server = argv[1];
+    get_args(argc - 1, argv + 1);
+    stats = std::make_unique<stats_t>();
+    init_bots();
+
+    int epoll_fd = epoll_create1(0);
+    if (epoll_fd == -1)
+        syserr("epoll_create1");
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    for (uint32_t b = 0; b < bots.size(); b++) {
+        ev.data.u32 = b;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, bots[b].socket, &ev) == -1)
+            syserr("epoll_ctl socket");
+    }
+
+    // komunikaty co UPDATE_NANOSECOND_INTERVAL, jak w kliencie
+    int send_timer;
+    create_timer(send_timer, TIMER_SEND_UPDATE, -1);
+    ev.data.u32 = EPOLL_SEND_TIMER;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, send_timer, &ev) == -1)
+        syserr("epoll_ctl timer");
+
+    std::mt19937_64 rand(seed);
+    char buf[DATAGRAM_MAX_SIZE];
+    epoll_event ready_events[EPOLL_EVENTS_MAX];
+
+    uint64_t start = metrics_now_ns();
+    uint64_t end = start + (uint64_t) seconds * 1000000000;
+    send_updates(rand);
+
+    uint64_t now;
+    while ((now = metrics_now_ns()) < end) {
+        int timeout_ms = (int) ((end - now) / 1000000) + 1;
+        int ret = epoll_wait(epoll_fd, ready_events, EPOLL_EVENTS_MAX, timeout_ms);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            syserr("epoll_wait");
+        }
+
+        for (int i = 0; i < ret; i++) {
+            uint32_t b = ready_events[i].data.u32;
+            if (b == EPOLL_SEND_TIMER) {
+                uint64_t exp;
+                if (read(send_timer, &exp, sizeof(exp)) != sizeof(exp))
+                    syserr("timer");
+                send_updates(rand);
+            } else {
+                receive_events(bots[b], buf);
+            }
+        }
+    }
+
+    print_report(metrics_now_ns() - start);
+    return 0;
+}
@@ -0,0 +1,143 @@
+#include <cstdio>
+#include <cstdarg>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <unistd.h>
+#include "log.h"
+
+#define LOG_LINE_MAX 256
+#define LOG_RING_SIZE 4096          // potęga dwójki
+#define LOG_DRAIN_INTERVAL_MS 10
+
+namespace {
+    const char *const level_names[] = {"debug", "info", "warn", "error"};
+
+    struct log_slot_t {
+        std::atomic<uint64_t> sequence;
+        uint32_t size;
+        char line[LOG_LINE_MAX];
+    };
+
+    /* Ograniczona kolejka wielu producentów (wątki serwera) z numerami sekwencyjnymi
+     * w slotach (jak u Vyukova); konsumentem jest ten, kto trzyma mutex. */
+    struct log_ring_t {
+        log_slot_t slots[LOG_RING_SIZE];
+        alignas(64) std::atomic<uint64_t> head{0};
+        alignas(64) uint64_t tail = 0;
+        std::atomic<uint64_t> dropped{0};
+        std::mutex mutex;
+        std::condition_variable cv;
+        char out[LOG_RING_SIZE / 8 * LOG_LINE_MAX];
+    };
+
+    std::atomic<log_ring_t *> ring{nullptr};
+
+    void write_all(const char *buf, size_t size) {
+        while (size > 0) {
+            ssize_t ret = write(STDERR_FILENO, buf, size);
+            if (ret <= 0)
+                return;     // nie mamy gdzie zgłosić błędu logowania
+            buf += ret;
+            size -= ret;
+        }
+    }
+
+    /* przy trzymanym ring.mutex */
+    void drain(log_ring_t &r) {
+        size_t out_size = 0;
+        while (true) {
+            log_slot_t &slot = r.slots[r.tail & (LOG_RING_SIZE - 1)];
+            if (slot.sequence.load(std::memory_order_acquire) != r.tail + 1)
+                break;
+            if (out_size + slot.size > sizeof(r.out)) {
+                write_all(r.out, out_size);
+                out_size = 0;
+            }
+            memcpy(r.out + out_size, slot.line, slot.size);
+            out_size += slot.size;
+            slot.sequence.store(r.tail + LOG_RING_SIZE, std::memory_order_release);
+            r.tail++;
+        }
+
+        uint64_t dropped = r.dropped.exchange(0, std::memory_order_relaxed);
+        if (dropped > 0 && out_size + LOG_LINE_MAX <= sizeof(r.out))
+            out_size += snprintf(r.out + out_size, LOG_LINE_MAX, "[warn] log: dropped %lu lines\n",
+                                 (unsigned long) dropped);
+        write_all(r.out, out_size);
+    }
+
+    void drain_loop(log_ring_t &r) {
+        std::unique_lock<std::mutex> lock(r.mutex);
+        while (true) {
+            drain(r);
+            r.cv.wait_for(lock, std::chrono::milliseconds(LOG_DRAIN_INTERVAL_MS));
+        }
+    }
+
+    bool ring_push(log_ring_t &r, const char *line, size_t size) {
+        uint64_t pos = r.head.load(std::memory_order_relaxed);
+        log_slot_t *slot;
+        while (true) {
+            slot = &r.slots[pos & (LOG_RING_SIZE - 1)];
+            uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+            auto diff = (int64_t) (sequence - pos);
+            if (diff == 0) {
+                if (r.head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;   // pełny
+            } else {
+                pos = r.head.load(std::memory_order_relaxed);
+            }
+        }
+        memcpy(slot->line, line, size);
+        slot->size = (uint32_t) size;
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+}
+
+void log_init(bool async) {
+    if (!async || ring.load() != nullptr)
+        return;
+    auto *r = new log_ring_t;
+    for (uint64_t i = 0; i < LOG_RING_SIZE; i++)
+        r->slots[i].sequence.store(i, std::memory_order_relaxed);
+    std::thread(drain_loop, std::ref(*r)).detach();   // do końca procesu, resztę wypisze log_flush
+    ring.store(r);
+    std::atexit(log_flush);
+}
+
+void log_flush() {
+    log_ring_t *r = ring.load();
+    if (r == nullptr)
+        return;
+    std::lock_guard<std::mutex> lock(r->mutex);
+    drain(*r);
+}
+
+void log_write(int level, const char *fmt, ...) {
+    char line[LOG_LINE_MAX];
+    int prefix = snprintf(line, sizeof(line), "[%s] ", level_names[level]);
+
+    va_list fmt_args;
+    va_start(fmt_args, fmt);
+    int size = vsnprintf(line + prefix, sizeof(line) - prefix - 1, fmt, fmt_args);
+    va_end(fmt_args);
+
+    size_t len = prefix + std::min<size_t>(std::max(size, 0), sizeof(line) - prefix - 2);
+    line[len++] = '\n';
+
+    log_ring_t *r = ring.load(std::memory_order_acquire);
+    if (r == nullptr)
+        write_all(line, len);
+    else if (!ring_push(*r, line, len))
+        r->dropped.fetch_add(1, std::memory_order_relaxed);
+}
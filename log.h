@@ -0,0 +1,37 @@
+#ifndef SIK2_LOG_H
+#define SIK2_LOG_H
+
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_ERROR 3
+#define LOG_LEVEL_NONE 4
+
+/* Najniższy poziom, który w ogóle trafia do binarki (ustawiany z CMake przez SIK2_LOG_LEVEL).
+ * Wywołania poniżej tego poziomu znikają w czasie kompilacji razem z liczeniem argumentów. */
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+/* Domyślnie każda linia idzie od razu na stderr. Po log_init(true) linie trafiają do
+ * pierścienia w pamięci, a osobny wątek wypisuje je hurtem; gdy pierścień jest pełny,
+ * linie są gubione (z licznikiem), żeby logowanie nigdy nie blokowało pętli zdarzeń. */
+void log_init(bool async);
+
+/* wypisuje wszystko, co czeka w pierścieniu (syserr i fatal wołają to przed wyjściem) */
+void log_flush();
+
+void log_write(int level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+#define LOG_AT(level, ...)                          \
+    do {                                            \
+        if constexpr ((level) >= LOG_LEVEL)         \
+            log_write((level), __VA_ARGS__);        \
+    } while (0)
+
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+#endif //SIK2_LOG_H
@@ -0,0 +1,187 @@
+#include <cstdio>
+#include <ctime>
+#include <algorithm>
+#include <memory>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "common.h"
+#include "metrics.h"
+
+namespace {
+    inline uint64_t load(const std::atomic<uint64_t> &value) {
+        return value.load(std::memory_order_relaxed);
+    }
+
+    size_t bucket_of(uint64_t value) {
+        if (value >= ((uint64_t) 1 << METRIC_MAX_BITS))
+            value = ((uint64_t) 1 << METRIC_MAX_BITS) - 1;
+        if (value < (1 << METRIC_SUB_BITS))
+            return value;
+        unsigned shift = 63 - __builtin_clzll(value) - METRIC_SUB_BITS;
+        return ((shift + 1) << METRIC_SUB_BITS) + (value >> shift) - (1 << METRIC_SUB_BITS);
+    }
+
+    /* największa wartość trafiająca do kubełka */
+    uint64_t bucket_upper(size_t bucket) {
+        if (bucket < (1 << METRIC_SUB_BITS))
+            return bucket;
+        unsigned shift = (bucket >> METRIC_SUB_BITS) - 1;
+        uint64_t mantissa = (bucket & ((1 << METRIC_SUB_BITS) - 1)) + (1 << METRIC_SUB_BITS);
+        return ((mantissa + 1) << shift) - 1;
+    }
+
+    struct histogram_sum_t {
+        uint64_t buckets[METRIC_HISTOGRAM_BUCKETS] = {};
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t max = 0;
+    };
+
+    uint64_t percentile(const histogram_sum_t &histogram, double p) {
+        if (histogram.count == 0)
+            return 0;
+        auto rank = (uint64_t) (p * (double) (histogram.count - 1)) + 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < METRIC_HISTOGRAM_BUCKETS; i++) {
+            seen += histogram.buckets[i];
+            if (seen >= rank)
+                return std::min(bucket_upper(i), histogram.max);
+        }
+        return histogram.max;
+    }
+
+    void append_line(std::string &out, const char *name, uint64_t value) {
+        char line[128];
+        int len = snprintf(line, sizeof(line), "%s %lu\n", name, (unsigned long) value);
+        out.append(line, len);
+    }
+
+    void append_histogram(std::string &out, const char *name, const histogram_sum_t &histogram) {
+        static const struct {
+            const char *suffix;
+            double p;
+        } percentiles[] = {{"p50", 0.5}, {"p90", 0.9}, {"p99", 0.99}, {"p999", 0.999}};
+
+        std::string prefix = name;
+        append_line(out, (prefix + "_count").c_str(), histogram.count);
+        append_line(out, (prefix + "_sum").c_str(), histogram.sum);
+        for (auto &percentile_def : percentiles)
+            append_line(out, (prefix + "_" + percentile_def.suffix).c_str(),
+                        percentile(histogram, percentile_def.p));
+        append_line(out, (prefix + "_max").c_str(), histogram.max);
+    }
+
+    void add_histogram(histogram_sum_t &total, const metric_histogram_t &histogram) {
+        for (size_t i = 0; i < METRIC_HISTOGRAM_BUCKETS; i++)
+            total.buckets[i] += load(histogram.buckets[i]);
+        total.count += load(histogram.count.value);
+        total.sum += load(histogram.sum.value);
+        total.max = std::max(total.max, load(histogram.max));
+    }
+}
+
+void metric_record(metric_histogram_t &histogram, uint64_t value) {
+    std::atomic<uint64_t> &bucket = histogram.buckets[bucket_of(value)];
+    bucket.store(load(bucket) + 1, std::memory_order_relaxed);
+    metric_add(histogram.count, 1);
+    metric_add(histogram.sum, value);
+    if (value > load(histogram.max))
+        histogram.max.store(value, std::memory_order_relaxed);
+}
+
+uint64_t metric_percentile(const metric_histogram_t &histogram, double p) {
+    auto total = std::make_unique<histogram_sum_t>();
+    add_histogram(*total, histogram);
+    return percentile(*total, p);
+}
+
+uint64_t metrics_now_ns() {
+    timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+std::string metrics_snapshot(const std::vector<metrics_t *> &sources) {
+    static const struct {
+        const char *name;
+        metric_counter_t metrics_t::*counter;
+    } counters[] = {
+            {"datagrams_in", &metrics_t::datagrams_in},
+            {"bytes_in", &metrics_t::bytes_in},
+            {"invalid_msgs", &metrics_t::invalid_msgs},
+            {"ignored_msgs", &metrics_t::ignored_msgs},
+            {"datagrams_out", &metrics_t::datagrams_out},
+            {"bytes_out", &metrics_t::bytes_out},
+            {"dropped_sends", &metrics_t::dropped_sends},
+            {"history_datagrams", &metrics_t::history_datagrams},
+            {"history_bytes", &metrics_t::history_bytes},
+            {"events", &metrics_t::events},
+            {"rounds", &metrics_t::rounds},
+            {"games", &metrics_t::games},
+            {"players", &metrics_t::players},
+            {"observers", &metrics_t::observers},
+    };
+
+    std::string out;
+    for (auto &counter : counters) {
+        uint64_t total = 0;
+        for (metrics_t *metrics : sources)
+            total += load((metrics->*counter.counter).value);
+        append_line(out, counter.name, total);
+    }
+
+    auto turn = std::make_unique<histogram_sum_t>();
+    auto lateness = std::make_unique<histogram_sum_t>();
+    for (metrics_t *metrics : sources) {
+        add_histogram(*turn, metrics->turn_ns);
+        add_histogram(*lateness, metrics->round_lateness_ns);
+    }
+    append_histogram(out, "turn_ns", *turn);
+    append_histogram(out, "round_lateness_ns", *lateness);
+    return out;
+}
+
+int metrics_listen(int port) {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock == -1)
+        syserr("metrics socket");
+
+    int on = 1;
+    if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (char *) &on, sizeof(on)) < 0)
+        syserr("metrics setsockopt");
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);   // tylko lokalnie
+    if (bind(sock, (sockaddr *) &addr, sizeof(addr)) == -1)
+        syserr("metrics bind");
+    if (listen(sock, 16) == -1)
+        syserr("metrics listen");
+    return sock;
+}
+
+void metrics_serve(int listen_socket, std::vector<metrics_t *> sources) {
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "EndlessLoop"
+    while (true) {
+        int sock = accept(listen_socket, NULL, NULL);
+        if (sock == -1)
+            continue;   // np. klient rozłączył się przed accept
+
+        std::string snapshot = metrics_snapshot(sources);
+        const char *data = snapshot.data();
+        size_t left = snapshot.size();
+        while (left > 0) {
+            ssize_t ret = write(sock, data, left);
+            if (ret <= 0)
+                break;
+            data += ret;
+            left -= ret;
+        }
+        close(sock);
+    }
+#pragma clang diagnostic pop
+}
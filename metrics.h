@@ -0,0 +1,73 @@
+#ifndef SIK2_METRICS_H
+#define SIK2_METRICS_H
+
+#include <cstdint>
+#include <atomic>
+#include <string>
+#include <vector>
+
+/* Metryki jednego wątku serwera. Każde pole zapisuje tylko właściciel (zwykłe load + store,
+ * bez instrukcji z lock), a wątek metryk tylko czyta, więc atomiki są potrzebne wyłącznie
+ * po to, żeby odczyt z innego wątku był poprawny. */
+struct metric_counter_t {
+    std::atomic<uint64_t> value{0};
+};
+
+inline void metric_add(metric_counter_t &counter, uint64_t n) {
+    counter.value.store(counter.value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+inline void metric_sub(metric_counter_t &counter, uint64_t n) {
+    counter.value.store(counter.value.load(std::memory_order_relaxed) - n, std::memory_order_relaxed);
+}
+
+/* Histogram w stylu HDR: wartości poniżej 2^METRIC_SUB_BITS mają własne kubełki, wyżej każda
+ * potęga dwójki dzieli się na 2^METRIC_SUB_BITS równych kubełków (błąd względny do 1/16). */
+#define METRIC_SUB_BITS 4
+#define METRIC_MAX_BITS 40          // wartości (w ns) powyżej 2^40 (ok. 18 minut) są przycinane
+#define METRIC_HISTOGRAM_BUCKETS ((METRIC_MAX_BITS - METRIC_SUB_BITS + 1) << METRIC_SUB_BITS)
+
+struct metric_histogram_t {
+    std::atomic<uint64_t> buckets[METRIC_HISTOGRAM_BUCKETS]{};
+    metric_counter_t count;
+    metric_counter_t sum;
+    std::atomic<uint64_t> max{0};
+};
+
+void metric_record(metric_histogram_t &histogram, uint64_t value);
+
+/* górna granica kubełka, w którym leży percentyl p (0..1), nie większa niż max */
+uint64_t metric_percentile(const metric_histogram_t &histogram, double p);
+
+struct metrics_t {
+    metric_counter_t datagrams_in;
+    metric_counter_t bytes_in;
+    metric_counter_t invalid_msgs;      // za krótkie, zły kierunek, niedozwolone znaki w nazwie
+    metric_counter_t ignored_msgs;      // poprawne, ale odrzucone (np. stara sesja gracza)
+    metric_counter_t datagrams_out;
+    metric_counter_t bytes_out;
+    metric_counter_t dropped_sends;     // pełny bufor gniazda albo błąd wysyłania
+    metric_counter_t history_datagrams;
+    metric_counter_t history_bytes;
+    metric_counter_t events;
+    metric_counter_t rounds;
+    metric_counter_t games;
+    metric_counter_t players;           // aktywne sesje graczy (gauge)
+    metric_counter_t observers;         // aktywne sesje obserwatorów (gauge)
+    metric_histogram_t turn_ns;         // czas do_turn w jednym pokoju
+    metric_histogram_t round_lateness_ns;   // opóźnienie obsługi timera tury względem terminu
+};
+
+/* tekstowy zrzut (linie "nazwa wartość") sumy metryk wszystkich wątków */
+std::string metrics_snapshot(const std::vector<metrics_t *> &sources);
+
+/* Nasłuchuje na 127.0.0.1:port i każdemu połączeniu wysyła zrzut metryk, po czym je zamyka.
+ * Nie wraca; uruchamiane w osobnym wątku. */
+void metrics_serve(int listen_socket, std::vector<metrics_t *> sources);
+
+/* gniazdo nasłuchujące dla metrics_serve, tworzone przed uruchomieniem wątków */
+int metrics_listen(int port);
+
+uint64_t metrics_now_ns();
+
+#endif //SIK2_METRICS_H
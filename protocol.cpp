@@ -0,0 +1,32 @@
+#include <cstring>
+#include <algorithm>
+#include <endian.h>
+#include "protocol.h"
+
+size_t client_msg_encode(client_msg &msg, uint64_t session_id, uint8_t turn_direction,
+                         uint32_t next_expected_event_no, const std::string &player_name) {
+    msg = {htobe64(session_id), turn_direction, htobe32(next_expected_event_no), 0};
+    size_t name_len = std::min(player_name.size(), (size_t) NAME_LEN_MAX);
+    memcpy(msg.player_name, player_name.data(), name_len);
+    return 13 + name_len;
+}
+
+size_t event_parse(const char *buf, size_t size, event_view_t &event) {
+    if (size < 17)
+        return 0;   // nawet pusty event ma game_id, len, event_no, typ i crc
+
+    uint32_t len = be32toh(*(uint32_t *) (buf + 4));
+    if (len < 5 || len > size - 12)
+        return 0;
+
+    uint32_t sent_crc32 = be32toh(*(uint32_t *) (buf + len + 8));
+    if (crc32buf(buf + 4, len + 4) != sent_crc32)
+        return 0;
+
+    event.game_id = be32toh(*(uint32_t *) buf);
+    event.len = len;
+    event.event_no = be32toh(*(uint32_t *) (buf + 8));
+    event.type = *(uint8_t *) (buf + 12);
+    event.data = buf;
+    return len + 12;
+}
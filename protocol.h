@@ -0,0 +1,29 @@
+#ifndef SIK2_PROTOCOL_H
+#define SIK2_PROTOCOL_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include "common.h"
+
+/* Strona klienta protokołu, wspólna dla klienta z gui i generatora obciążenia. */
+
+/* wypełnia msg i zwraca liczbę bajtów do wysłania (13 + długość nazwy) */
+size_t client_msg_encode(client_msg &msg, uint64_t session_id, uint8_t turn_direction,
+                         uint32_t next_expected_event_no, const std::string &player_name);
+
+/* nagłówek eventu odczytany z datagramu; data wskazuje początek eventu (pole game_id) */
+struct event_view_t {
+    uint32_t game_id;
+    uint32_t len;
+    uint32_t event_no;
+    uint8_t type;
+    const char *data;
+};
+
+/* Odczytuje event z początku buf (size - bajty do końca datagramu) i sprawdza crc. Zwraca
+ * rozmiar całego eventu (len + 12) albo 0, jeśli event jest ucięty lub crc się nie zgadza -
+ * wtedy reszty datagramu nie da się już podzielić na eventy. */
+size_t event_parse(const char *buf, size_t size, event_view_t &event);
+
+#endif //SIK2_PROTOCOL_H
@@ -0,0 +1,173 @@
+#include <cstring>
+#include <memory>
+#include <endian.h>
+#include "record.h"
+#include "metrics.h"
+#include "room.h"
+
+#define RECORD_MAGIC 0x32524b53     // "SKR2" w little-endian
+#define RECORD_VERSION 1
+#define RECORD_BUFFER_SIZE 65536
+
+namespace {
+    enum : uint8_t {
+        REC_SOURCE = 0,     // nowy nadawca: sin6_addr, sin6_port
+        REC_MSG = 1,        // varint nadawca, bajt długości, komunikat
+        REC_ROUND = 2,      // varint exp
+    };
+
+    struct __attribute__((__packed__)) record_header_t {
+        uint32_t magic;
+        uint8_t version;
+        uint32_t seed;
+        int32_t turning_speed;
+        int32_t rounds_per_sec;
+        int32_t board_width;
+        int32_t board_height;
+        uint8_t fixed_point;
+    };
+
+    void write_varint(FILE *file, uint64_t value) {
+        uint8_t buf[10];
+        size_t size = 0;
+        do {
+            buf[size] = value & 0x7f;
+            value >>= 7;
+            if (value != 0)
+                buf[size] |= 0x80;
+            size++;
+        } while (value != 0);
+        fwrite(buf, 1, size, file);
+    }
+
+    bool read_varint(FILE *file, uint64_t &value) {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            int c = fgetc(file);
+            if (c == EOF)
+                return false;
+            value |= (uint64_t) (c & 0x7f) << shift;
+            if (!(c & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    std::string source_key(const sockaddr_in6 &address) {
+        std::string key((const char *) &address.sin6_addr, sizeof(address.sin6_addr));
+        key.append((const char *) &address.sin6_port, sizeof(address.sin6_port));
+        return key;
+    }
+
+    struct replay_sink_t {
+        replay_result_t *result;
+    };
+
+    /* room_t::send przy odtwarzaniu: nic nie wysyła, tylko liczy skrót wysłanych danych */
+    void replay_send(room_t &room, mmsghdr *msgs, size_t count) {
+        replay_result_t &result = *static_cast<replay_sink_t *>(room.send_ctx)->result;
+        for (size_t i = 0; i < count; i++) {
+            const iovec &iov = msgs[i].msg_hdr.msg_iov[0];
+            result.digest = crc32_update(result.digest, iov.iov_base, iov.iov_len);
+            result.bytes_out += iov.iov_len;
+        }
+        result.datagrams_out += count;
+    }
+}
+
+void record_open(recorder_t &recorder, const std::string &path, uint32_t seed, const room_config_t &config) {
+    recorder.file = fopen(path.c_str(), "wb");
+    if (recorder.file == nullptr)
+        syserr("fopen %s", path.c_str());
+    setvbuf(recorder.file, nullptr, _IOFBF, RECORD_BUFFER_SIZE);
+
+    record_header_t header{htole32(RECORD_MAGIC), RECORD_VERSION, htole32(seed),
+                           (int32_t) htole32(config.turning_speed), (int32_t) htole32(config.rounds_per_sec),
+                           (int32_t) htole32(config.board_width), (int32_t) htole32(config.board_height),
+                           config.fixed_point};
+    if (fwrite(&header, sizeof(header), 1, recorder.file) != 1)
+        syserr("write record header");
+}
+
+void record_client_msg(recorder_t &recorder, const client_msg &msg, int len, const sockaddr_in6 &address) {
+    auto [source, added] = recorder.sources.try_emplace(source_key(address), recorder.sources.size());
+    if (added) {
+        fputc(REC_SOURCE, recorder.file);
+        fwrite(&address.sin6_addr, sizeof(address.sin6_addr), 1, recorder.file);
+        fwrite(&address.sin6_port, sizeof(address.sin6_port), 1, recorder.file);
+    }
+    fputc(REC_MSG, recorder.file);
+    write_varint(recorder.file, source->second);
+    fputc(len, recorder.file);
+    fwrite(&msg, 1, len, recorder.file);
+}
+
+void record_round(recorder_t &recorder, uint64_t exp) {
+    fputc(REC_ROUND, recorder.file);
+    write_varint(recorder.file, exp);
+    // błąd zapisu dowolnego rekordu od poprzedniej tury zostaje w pliku do ferror
+    if (ferror(recorder.file) || fflush(recorder.file) != 0)
+        syserr("write record");
+}
+
+void replay_run(const std::string &path, replay_result_t &result) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == nullptr)
+        syserr("fopen %s", path.c_str());
+    setvbuf(file, nullptr, _IOFBF, RECORD_BUFFER_SIZE);
+
+    record_header_t header{};
+    if (fread(&header, sizeof(header), 1, file) != 1 || le32toh(header.magic) != RECORD_MAGIC)
+        fatal("%s is not a server recording", path.c_str());
+    if (header.version != RECORD_VERSION)
+        fatal("unsupported recording version %d", (int) header.version);
+
+    room_config_t config{(int32_t) le32toh(header.turning_speed), (int32_t) le32toh(header.rounds_per_sec),
+                         (int32_t) le32toh(header.board_width), (int32_t) le32toh(header.board_height),
+                         header.fixed_point != 0};
+    auto room = std::make_unique<room_t>();
+    auto metrics = std::make_unique<metrics_t>();
+    replay_sink_t sink{&result};
+    room_init(*room, 0, -1, config, le32toh(header.seed));
+    room->send = replay_send;
+    room->send_ctx = &sink;
+    room->metrics = metrics.get();
+
+    std::vector<sockaddr_in6> sources;
+    client_msg msg{};
+    uint64_t start = metrics_now_ns();
+    int tag;
+    // ucięty ostatni rekord (serwer zabity w trakcie tury) po prostu kończy odtwarzanie
+    while ((tag = fgetc(file)) != EOF) {
+        if (tag == REC_SOURCE) {
+            sockaddr_in6 &address = sources.emplace_back();
+            address.sin6_family = AF_INET6;
+            if (fread(&address.sin6_addr, sizeof(address.sin6_addr), 1, file) != 1 ||
+                fread(&address.sin6_port, sizeof(address.sin6_port), 1, file) != 1)
+                break;
+        } else if (tag == REC_MSG) {
+            uint64_t source;
+            int len;
+            if (!read_varint(file, source) || (len = fgetc(file)) == EOF)
+                break;
+            if (source >= sources.size() || len > (int) sizeof(msg))
+                fatal("corrupted recording");
+            if (fread(&msg, 1, len, file) != (size_t) len)
+                break;
+            room_handle_client_msg(*room, msg, len, sources[source]);
+            result.msgs++;
+        } else if (tag == REC_ROUND) {
+            uint64_t exp;
+            if (!read_varint(file, exp))
+                break;
+            room_handle_round(*room, exp);
+            result.rounds++;
+        } else {
+            fatal("corrupted recording");
+        }
+    }
+    result.elapsed_ns = metrics_now_ns() - start;
+    result.games = metrics->games.value.load();
+    result.events = metrics->events.value.load();
+    fclose(file);
+}
@@ -0,0 +1,48 @@
+#ifndef SIK2_RECORD_H
+#define SIK2_RECORD_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <netinet/in.h>
+#include "common.h"
+
+struct room_config_t;
+
+/* Zapis wejścia jednego pokoju: nagłówek (ziarno i parametry gry), a potem w kolejności
+ * obsługi przyjęte komunikaty klientów i tury. Numer tury komunikatu wynika z liczby
+ * wcześniejszych rekordów tury, a nadawca to numer adresu nadanego przy pierwszym
+ * komunikacie z tego adresu. Liczby w rekordach są zapisane jako varint (LEB128).
+ *
+ * Odtworzenie pliku przepuszcza te same wywołania przez room_handle_client_msg
+ * i room_handle_round bez gniazd i timerów, więc gra przebiega identycznie. */
+struct recorder_t {
+    FILE *file = nullptr;
+    std::unordered_map<std::string, uint32_t> sources;  // sin6_addr + sin6_port -> numer nadawcy
+};
+
+void record_open(recorder_t &recorder, const std::string &path, uint32_t seed, const room_config_t &config);
+
+void record_client_msg(recorder_t &recorder, const client_msg &msg, int len, const sockaddr_in6 &address);
+
+/* Zapisuje turę i wypycha bufor pliku, więc po zabiciu serwera brakuje najwyżej bieżącej tury.
+ * Nieudany zapis tej albo wcześniejszych tur (np. pełny dysk) kończy program przez syserr,
+ * zamiast zostawić zapis, którego nie da się odtworzyć. */
+void record_round(recorder_t &recorder, uint64_t exp);
+
+struct replay_result_t {
+    uint64_t rounds = 0;
+    uint64_t msgs = 0;
+    uint64_t games = 0;
+    uint64_t events = 0;
+    uint64_t datagrams_out = 0;
+    uint64_t bytes_out = 0;
+    uint32_t digest = 0;        // crc wszystkich wysłanych datagramów, ten sam przy każdym odtworzeniu
+    uint64_t elapsed_ns = 0;
+};
+
+/* odtwarza plik tak szybko, jak się da; błędny plik kończy program przez fatal */
+void replay_run(const std::string &path, replay_result_t &result);
+
+#endif //SIK2_RECORD_H
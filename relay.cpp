@@ -0,0 +1,405 @@
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <getopt.h>
+#include <cstring>
+#include <cerrno>
+#include <netdb.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "common.h"
+#include "event_log.h"
+#include "session_table.h"
+#include "timeout_wheel.h"
+#include "reorder.h"
+#include "protocol.h"
+#include "log.h"
+
+/* Przekaźnik obserwatorów: łączy się z serwerem (albo z innym przekaźnikiem) jako jeden
+ * obserwator, trzyma własną kopię logu bieżącej gry i obsługuje dowolnie wielu obserwatorów
+ * tym samym protokołem co serwer - historia z własnego logu, eventy na żywo rozsyłane zaraz
+ * po dotarciu z góry (zawsze unicastem, także do klientów z CLIENT_CAP_MULTICAST). Gracze
+ * muszą łączyć się bezpośrednio z serwerem. */
+
+#define DEFAULT_RELAY_PORT 2121
+#define RELAY_HISTORY_DATAGRAMS_MAX 64  // na jeden komunikat obserwatora, jak w serwerze
+#define MAX_CONSECUTIVE_MSG 256         // na jedno gniazdo, żeby nie zagłodzić drugiego
+#define EPOLL_EVENTS_MAX 4
+// terminy zerwania połączenia liczone w tyknięciach timera komunikatów do serwera
+#define RELAY_TIMEOUT_TICKS ((uint64_t) CLIENT_TIMEOUT_SECONDS * 1000000000 / UPDATE_NANOSECOND_INTERVAL)
+
+namespace {
+    enum : uint32_t {
+        EPOLL_UPSTREAM,
+        EPOLL_DOWNSTREAM,
+        EPOLL_SEND_TIMER,
+    };
+
+    /* event spoza kolejności w postaci z sieci, czeka w oknie porządkującym na brakujące */
+    struct relay_event_t {
+        uint32_t game_id;
+        uint32_t event_no;
+        uint16_t size;
+        char data[DATAGRAM_MAX_SIZE];
+    };
+
+    struct relay_t {
+        int upstream = -1;          // połączone gniazdo do serwera
+        int downstream = -1;        // gniazdo dla obserwatorów
+        uint64_t session_id = 0;
+
+        bool has_game = false;
+        uint32_t game_id = 0;
+        bool finished = false;      // game_over jest już w logu (albo gra zniknęła na górze)
+        event_log_t game_events;
+        reorder_window_t<relay_event_t> pending;    // eventy, przed którymi czegoś jeszcze brakuje
+        uint32_t forwarded = 0;     // eventy [0, forwarded) już rozesłane na żywo
+
+        session_table_t sessions;   // sami obserwatorzy
+        timeout_wheel_t timeout_wheel;
+        std::vector<timeout_entry_t> expired_observers;
+        std::vector<sockaddr_in6> recipients;
+        bool recipients_dirty = true;
+        std::vector<mmsghdr> msgs;
+        std::vector<iovec> iovs;
+    };
+
+    char *server;
+    char *server_port = NULL;
+    char default_server_port[] = "2021";
+    int listen_port = DEFAULT_RELAY_PORT;
+
+    void get_args(int argc, char *argv[]) {
+        int opt;
+        while ((opt = getopt(argc, argv, "p:l:")) != -1) {
+            switch (opt) {
+                case 'p':
+                    server_port = optarg;
+                    parse_number(server_port, 2, 65535, "server port");
+                    break;
+                case 'l':
+                    listen_port = parse_number(optarg, 2, 65535, "listen port");
+                    break;
+                default:
+                    fatal("Arguments: game_server [-p n] [-l n]\n");
+            }
+        }
+        if (argc - optind != 0)
+            fatal("Arguments: game_server [-p n] [-l n]\n");
+
+        if (server_port == NULL)
+            server_port = default_server_port;
+    }
+
+    int connect_upstream() {
+        addrinfo addr_hints{};
+        addr_hints.ai_family = AF_UNSPEC;
+        addr_hints.ai_socktype = SOCK_DGRAM;
+        addr_hints.ai_protocol = IPPROTO_UDP;
+        addrinfo *addr_result;
+
+        if (getaddrinfo(server, server_port, &addr_hints, &addr_result) != 0)
+            syserr("getaddrinfo server");
+
+        int sock = socket(addr_result->ai_family, addr_result->ai_socktype, addr_result->ai_protocol);
+        if (sock < 0)
+            syserr("socket server");
+        if (connect(sock, addr_result->ai_addr, addr_result->ai_addrlen))
+            syserr("connect server");
+        freeaddrinfo(addr_result);
+
+        if (fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK) == -1)
+            syserr("fcntl server");
+        return sock;
+    }
+
+    int create_downstream_socket() {
+        int sock = socket(PF_INET6, SOCK_DGRAM, 0);
+        if (sock == -1)
+            syserr("socket");
+
+        int on = 1;
+        if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (char *) &on, sizeof(on)) < 0)
+            syserr("setsockopt");
+
+        if (fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK) == -1)
+            syserr("fcntl");
+
+        sockaddr_in6 address{};
+        address.sin6_family = AF_INET6;
+        address.sin6_port = htons(listen_port);
+        address.sin6_addr = in6addr_any;
+        if (bind(sock, (struct sockaddr *) &address, (socklen_t) sizeof(address)) == -1)
+            syserr("bind");
+        return sock;
+    }
+
+    /* sendmmsg po kawałkach; przy pełnym buforze gniazda reszta przepada, obserwatorzy dopytają */
+    void send_msgs(relay_t &relay, mmsghdr *msgs, size_t count) {
+        size_t sent = 0;
+        while (sent < count) {
+            unsigned int chunk = std::min(count - sent, (size_t) UIO_MAXIOV);
+            int ret = sendmmsg(relay.downstream, msgs + sent, chunk, 0);
+            if (ret == -1) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    break;
+                sent++;     // błąd dotyczy pierwszego komunikatu, pomijamy go
+                continue;
+            }
+            sent += ret;
+        }
+    }
+
+    void send_request(relay_t &relay) {
+        // po końcu gry prosimy o event 0 następnej, jak klient
+        uint32_t expected_event_no = relay.has_game && !relay.finished ? event_log_count(relay.game_events) : 0;
+        client_msg msg{};
+        size_t len = client_msg_encode(msg, relay.session_id, 0, expected_event_no, "");
+        write(relay.upstream, &msg, len);   // przy pełnym buforze po prostu gubimy, jak klient
+    }
+
+    /* rozsyła eventy [relay.forwarded, koniec logu) do wszystkich obserwatorów */
+    void forward_new_events(relay_t &relay) {
+        event_log_t &game_events = relay.game_events;
+        uint32_t event_count = event_log_count(game_events);
+        if (relay.forwarded >= event_count)
+            return;
+
+        if (relay.recipients_dirty) {
+            relay.recipients.clear();
+            for (session_t &session : relay.sessions.sessions) {
+                if (session.live)
+                    relay.recipients.push_back(session.address);
+            }
+            relay.recipients_dirty = false;
+        }
+
+        relay.iovs.clear();
+        for (uint32_t first = relay.forwarded; first < event_count;) {
+            uint32_t last = event_log_datagram_end(game_events, first);
+            relay.iovs.push_back({(void *) event_log_at(game_events, first), event_log_bytes(game_events, first, last)});
+            first = last;
+        }
+        relay.forwarded = event_count;
+
+        size_t msg_count = relay.iovs.size() * relay.recipients.size();
+        relay.msgs.resize(msg_count);
+        size_t m = 0;
+        for (iovec &iov : relay.iovs) {
+            for (sockaddr_in6 &address : relay.recipients) {
+                msghdr &hdr = relay.msgs[m++].msg_hdr;
+                hdr = {};
+                hdr.msg_name = &address;
+                hdr.msg_namelen = sizeof(address);
+                hdr.msg_iov = &iov;
+                hdr.msg_iovlen = 1;
+            }
+        }
+        send_msgs(relay, relay.msgs.data(), msg_count);
+    }
+
+    void append_event(relay_t &relay, const char *event, size_t size) {
+        event_log_append(relay.game_events, event, size);
+        if (*(uint8_t *) (event + 12) == TYPE_GAME_OVER) {
+            relay.finished = true;
+            LOG_INFO("game %u over after %u events", relay.game_id, event_log_count(relay.game_events));
+        }
+    }
+
+    void handle_upstream_event(relay_t &relay, const event_view_t &event) {
+        if (!relay.has_game || event.game_id != relay.game_id) {
+            if (event.type != TYPE_NEW_GAME) {
+                // gra, której początku nie mamy - prosimy o nią od eventu 0
+                relay.finished = true;
+                return;
+            }
+            relay.has_game = true;
+            relay.game_id = event.game_id;
+            relay.finished = false;
+            event_log_clear(relay.game_events);
+            relay.forwarded = 0;
+            LOG_INFO("new game %u", relay.game_id);
+        }
+
+        uint32_t event_count = event_log_count(relay.game_events);
+        size_t size = event.len + 12;
+        if (event.event_no < event_count)
+            return;     // duplikat
+        if (event.event_no > event_count) {
+            // spoza okna przepada, dostaniemy go w historii, gdy okno do niego dojdzie
+            relay_event_t pending_event;
+            pending_event.game_id = event.game_id;
+            pending_event.event_no = event.event_no;
+            pending_event.size = (uint16_t) size;
+            memcpy(pending_event.data, event.data, size);
+            reorder_insert(relay.pending, event_count, pending_event);
+            return;
+        }
+
+        append_event(relay, event.data, size);
+        const relay_event_t *next;
+        while ((next = reorder_take(relay.pending, event_log_count(relay.game_events), relay.game_id)) != nullptr)
+            append_event(relay, next->data, next->size);
+    }
+
+    void receive_upstream(relay_t &relay) {
+        char buf[DATAGRAM_MAX_SIZE];
+        for (int t = 0; t < MAX_CONSECUTIVE_MSG; t++) {
+            ssize_t ret = read(relay.upstream, buf, sizeof(buf));
+            if (ret < 0)
+                break;      // EAGAIN albo np. ICMP port unreachable, gdy serwer jeszcze nie wstał
+
+            const char *event_buf = buf;
+            while (ret > 0) {
+                event_view_t event{};
+                size_t event_size = event_parse(event_buf, ret, event);
+                if (event_size == 0) {
+                    LOG_DEBUG("truncated event or crc32 mismatch");
+                    break;
+                }
+                handle_upstream_event(relay, event);
+                event_buf += event_size;
+                ret -= (ssize_t) event_size;
+            }
+        }
+        forward_new_events(relay);
+    }
+
+    void send_history(relay_t &relay, uint32_t expected_event_no, sockaddr_in6 &address) {
+        // obserwator po końcu gry czeka na następną, tak jak przy serwerze
+        if (!relay.has_game || (relay.finished && expected_event_no == 0))
+            return;
+
+        size_t datagram_count = event_log_history(relay.game_events, expected_event_no, relay.iovs,
+                                                  RELAY_HISTORY_DATAGRAMS_MAX);
+        relay.msgs.resize(datagram_count);
+        for (size_t i = 0; i < datagram_count; i++) {
+            msghdr &hdr = relay.msgs[i].msg_hdr;
+            hdr = {};
+            hdr.msg_name = &address;
+            hdr.msg_namelen = sizeof(address);
+            hdr.msg_iov = &relay.iovs[i];
+            hdr.msg_iovlen = 1;
+        }
+        send_msgs(relay, relay.msgs.data(), datagram_count);
+    }
+
+    void handle_observer_msg(relay_t &relay, client_msg &msg, int len, sockaddr_in6 &address) {
+        if (len != 13 || (msg.turn_direction & ~CLIENT_CAPS) > 2)
+            return;     // błąd odbioru, zły kierunek albo gracz, który musi iść do serwera
+
+        client_id_t client_id{be64toh(msg.session_id), address.sin6_port, address.sin6_addr};
+        uint32_t slot = session_find(relay.sessions, client_id);
+        if (slot == SESSION_NONE) {
+            slot = session_insert(relay.sessions, client_id, SESSION_OBSERVER, address);
+            timeout_wheel_add(relay.timeout_wheel, relay.sessions, slot);
+            relay.recipients_dirty = true;
+        } else {
+            timeout_wheel_refresh(relay.timeout_wheel, relay.sessions, slot);
+        }
+
+        uint32_t expected_event_no = be32toh(msg.next_expected_event_no);
+        if ((msg.turn_direction & CLIENT_CAP_KEYFRAME) && (expected_event_no & KEYFRAME_REQUEST))
+            expected_event_no = 1;  // przekaźnik nie ma klatek, po new_game wystarczą eventy od 1
+        send_history(relay, expected_event_no, address);
+    }
+
+    void receive_downstream(relay_t &relay) {
+        client_msg msg{};
+        sockaddr_in6 address{};
+        for (int t = 0; t < MAX_CONSECUTIVE_MSG; t++) {
+            socklen_t address_len = sizeof(address);
+            ssize_t ret = recvfrom(relay.downstream, &msg, sizeof(msg), 0, (sockaddr *) &address, &address_len);
+            if (ret < 0)
+                break;
+            handle_observer_msg(relay, msg, (int) ret, address);
+        }
+    }
+
+    void kick_timeouted_observers(relay_t &relay, uint64_t ticks) {
+        timeout_wheel_advance(relay.timeout_wheel, relay.sessions, ticks, relay.expired_observers);
+        for (timeout_entry_t &entry : relay.expired_observers) {
+            if (!timeout_entry_valid(relay.sessions, entry))
+                continue;
+            LOG_INFO("disconnecting observer with session %lu",
+                     (unsigned long) relay.sessions.sessions[entry.slot].id.session_id);
+            session_erase(relay.sessions, entry.slot);
+            relay.recipients_dirty = true;
+        }
+        relay.expired_observers.clear();
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2)
+        fatal("Arguments: game_server [-p n] [-l n]\n");
+
+    server = argv[1];
+    get_args(argc - 1, argv + 1);
+
+    relay_t relay;
+    timeval tv{};
+    gettimeofday(&tv, NULL);
+    relay.session_id = 1000000 * tv.tv_sec + tv.tv_usec;
+    session_table_init(relay.sessions, ((uint64_t) std::random_device{}() << 32) | std::random_device{}());
+    timeout_wheel_init(relay.timeout_wheel, RELAY_TIMEOUT_TICKS);
+    relay.upstream = connect_upstream();
+    relay.downstream = create_downstream_socket();
+
+    int epoll_fd = epoll_create1(0);
+    if (epoll_fd == -1)
+        syserr("epoll_create1");
+
+    // komunikaty do serwera co UPDATE_NANOSECOND_INTERVAL, jak w kliencie
+    int send_timer;
+    create_timer(send_timer, TIMER_SEND_UPDATE, -1);
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    int fds[] = {relay.upstream, relay.downstream, send_timer};
+    for (uint32_t i = EPOLL_UPSTREAM; i <= EPOLL_SEND_TIMER; i++) {
+        ev.data.u32 = i;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fds[i], &ev) == -1)
+            syserr("epoll_ctl");
+    }
+
+    LOG_INFO("relaying %s port %s on port %d", server, server_port, listen_port);
+    send_request(relay);
+    epoll_event ready_events[EPOLL_EVENTS_MAX];
+
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "EndlessLoop"
+    while (true) {
+        int ret = epoll_wait(epoll_fd, ready_events, EPOLL_EVENTS_MAX, -1);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            syserr("epoll_wait");
+        }
+
+        for (int i = 0; i < ret; i++) {
+            switch (ready_events[i].data.u32) {
+                case EPOLL_UPSTREAM:
+                    receive_upstream(relay);
+                    break;
+                case EPOLL_DOWNSTREAM:
+                    receive_downstream(relay);
+                    break;
+                case EPOLL_SEND_TIMER: {
+                    uint64_t exp;
+                    if (read(send_timer, &exp, sizeof(exp)) != sizeof(exp))
+                        syserr("timer");
+                    kick_timeouted_observers(relay, exp);
+                    send_request(relay);
+                    break;
+                }
+            }
+        }
+    }
+#pragma clang diagnostic pop
+    return 0;
+}
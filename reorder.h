@@ -0,0 +1,49 @@
+#ifndef SIK2_REORDER_H
+#define SIK2_REORDER_H
+
+#include <cstdint>
+#include <vector>
+
+#define REORDER_WINDOW 4096     // potęga dwójki
+
+/* Okno porządkujące: eventy, które wyprzedziły oczekiwany, czekają w tablicy cyklicznej pod
+ * indeksem event_no % REORDER_WINDOW, aż przyjdą brakujące wcześniejsze. Pamięć jest stała
+ * (REORDER_WINDOW slotów zaalokowanych raz), a slot pamięta event_no i game_id swojego eventu,
+ * więc przesunięcie okna ani zmiana gry niczego nie czyszczą - nieaktualny slot po prostu
+ * nie pasuje przy wyjmowaniu. event_t to dowolny typ z polami event_no i game_id: klient
+ * trzyma eventy zdekodowane (gui_event_t), przekaźnik w postaci z sieci (relay_event_t). */
+template<typename event_t>
+struct reorder_slot_t {
+    bool present = false;
+    event_t event{};
+};
+
+template<typename event_t>
+struct reorder_window_t {
+    std::vector<reorder_slot_t<event_t>> slots = std::vector<reorder_slot_t<event_t>>(REORDER_WINDOW);
+};
+
+/* Zapamiętuje event o numerze z [first, first + REORDER_WINDOW), gdzie first to pierwszy
+ * oczekiwany event. Dalsze eventy są odrzucane (zwraca false) - odbiorca wciąż prosi
+ * o historię od first, więc serwer dośle je, gdy okno do nich dojdzie. */
+template<typename event_t>
+bool reorder_insert(reorder_window_t<event_t> &window, uint32_t first, const event_t &event) {
+    if (event.event_no < first || event.event_no - first >= REORDER_WINDOW)
+        return false;
+    reorder_slot_t<event_t> &slot = window.slots[event.event_no & (REORDER_WINDOW - 1)];
+    slot.present = true;
+    slot.event = event;
+    return true;
+}
+
+/* wyjmuje event event_no gry game_id, jeśli czeka w oknie; inaczej nullptr */
+template<typename event_t>
+const event_t *reorder_take(reorder_window_t<event_t> &window, uint32_t event_no, uint32_t game_id) {
+    reorder_slot_t<event_t> &slot = window.slots[event_no & (REORDER_WINDOW - 1)];
+    if (!slot.present || slot.event.event_no != event_no || slot.event.game_id != game_id)
+        return nullptr;
+    slot.present = false;
+    return &slot.event;
+}
+
+#endif //SIK2_REORDER_H
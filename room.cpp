@@ -0,0 +1,579 @@
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <random>
+#include <string_view>
+#include <endian.h>
+#include "common.h"
+#include "event_log.h"
+#include "room.h"
+#include "log.h"
+#include "trig.h"
+#include "record.h"
+
+namespace {
+    uint32_t get_random(room_t &room) {
+        uint32_t result = (uint32_t) room.my_rand;
+        room.my_rand = (room.my_rand * 279410273) % 4294967291;
+        return result;
+    }
+
+    bool check_game_over(std::vector<player_info_t> &players) {
+        int alive_players = 0;
+        for (player_info_t &player: players) {
+            if (player.in_game)
+                alive_players++;
+        }
+
+        return alive_players == 1;
+    }
+
+    void rebuild_recipients(room_t &room) {
+        fanout_t &fanout = room.fanout;
+        fanout.recipients.clear();
+        if (room.multicast)
+            fanout.recipients.push_back(room.multicast_group);
+        // gracze disconnected nie mają już sesji
+        for (session_t &session: room.sessions.sessions) {
+            if (session.live && !(room.multicast && session.multicast))
+                fanout.recipients.push_back(session.address);
+        }
+        fanout.dirty = false;
+    }
+
+    /* wysyła eventy z bieżącej tury, spakowane w datagramy prosto z logu, do wszystkich
+     * odbiorców jednym wywołaniem room.send */
+    void send_to_all(room_t &room) {
+        fanout_t &fanout = room.fanout;
+        event_log_t &game_events = room.game_events;
+        if (fanout.dirty)
+            rebuild_recipients(room);
+
+        fanout.iovs.clear();
+        uint32_t event_count = event_log_count(game_events);
+        for (uint32_t first = room.tick_first_event_no; first < event_count;) {
+            uint32_t last = event_log_datagram_end(game_events, first);
+            fanout.iovs.push_back({(void *) event_log_at(game_events, first),
+                                   event_log_bytes(game_events, first, last)});
+            first = last;
+        }
+
+        size_t datagram_count = fanout.iovs.size();
+        size_t msg_count = datagram_count * fanout.recipients.size();
+        if (msg_count == 0)
+            return;
+
+        fanout.msgs.resize(msg_count);
+        size_t m = 0;
+        for (size_t i = 0; i < datagram_count; i++) {
+            for (sockaddr_in6 &addr : fanout.recipients) {
+                msghdr &hdr = fanout.msgs[m++].msg_hdr;
+                hdr = {};
+                hdr.msg_name = &addr;
+                hdr.msg_namelen = sizeof(addr);
+                hdr.msg_iov = &fanout.iovs[i];
+                hdr.msg_iovlen = 1;
+            }
+        }
+
+        room.send(room, fanout.msgs.data(), msg_count);
+    }
+
+    void flush_tick_batch(room_t &room) {
+        send_to_all(room);
+        uint32_t event_count = event_log_count(room.game_events);
+        room_metric_add(room, &metrics_t::events, event_count - room.tick_first_event_no);
+        room.tick_first_event_no = event_count;
+    }
+
+    void handle_player_elimination(room_t &room, player_info_t &player) {
+        event_log_t &game_events = room.game_events;
+        player.in_game = false;
+        event_player_eliminated event_elimination{htobe32(room.game_id),
+                                                  htobe32((uint32_t) sizeof(event_player_eliminated) - 12),
+                                                  htobe32((uint32_t) event_log_count(game_events)),
+                                                  TYPE_PLAYER_ELIMINATED, (uint8_t)player.number, 0};
+        event_elimination.crc32 = htobe32(crc32buf((char *) &event_elimination + 4, sizeof(event_player_eliminated) - 8));
+        event_log_append(game_events, &event_elimination, sizeof(event_elimination));
+
+        if (check_game_over(room.players)) {
+            room.game_in_progress = false;
+            event_game_over event_game_over{htobe32(room.game_id),
+                                            htobe32((uint32_t) sizeof(event_game_over) - 12),
+                                            htobe32((uint32_t) event_log_count(game_events)),
+                                            TYPE_GAME_OVER, 0};
+            event_game_over.crc32 = htobe32(crc32buf((char *) &event_game_over + 4, sizeof(event_game_over) - 8));
+            event_log_append(game_events, &event_game_over, sizeof(event_game_over));
+        }
+    }
+
+    void send_new_game(room_t &room) {
+        LOG_DEBUG("room %d: sending new game", room.index);
+        std::string player_list;
+        static const char placeholder = (char) 246; // placeholder char do zmiany na \0
+
+        for (uint32_t p : room.game_order)
+            player_list += room.players[p].name + placeholder;
+        uint32_t player_list_size = player_list.size();
+
+        char *player_list_data = player_list.data();
+        for (uint32_t i = 0; i < player_list_size; i++) {
+            if (player_list_data[i] == placeholder)
+                player_list_data[i] = '\0';
+        }
+
+        uint32_t len = 13 + player_list_size;
+
+        event_new_game event_new_game{htobe32(room.game_id), htobe32(len),
+                                      htobe32(event_log_count(room.game_events)), TYPE_NEW_GAME,
+                                      htobe32(room.config.board_width), htobe32(room.config.board_height), 0};
+
+        for (uint32_t i = 0; i < player_list_size; i++)
+            event_new_game.list_and_crc[i] = player_list_data[i];
+
+        uint32_t crc32 = htobe32(crc32buf((char *) &event_new_game + 4, len + 4));
+
+        memcpy((char *) &event_new_game + len + 8, &crc32, sizeof(uint32_t));
+
+        event_log_append(room.game_events, &event_new_game, len + 12);
+    }
+
+    void append_pixel(room_t &room, player_info_t &player, uint32_t x, uint32_t y) {
+        event_pixel event_pixel{htobe32(room.game_id),
+                                htobe32(sizeof(event_pixel) - 12),
+                                htobe32((uint32_t) event_log_count(room.game_events)),
+                                TYPE_PIXEL, (uint8_t) player.number,
+                                htobe32(x), htobe32(y), 0};
+        event_pixel.crc32 = htobe32(crc32buf((char *) &event_pixel + 4, sizeof(event_pixel) - 8));
+        event_log_append(room.game_events, &event_pixel, sizeof(event_pixel));
+    }
+
+    void init_game(room_t &room) {
+        uint32_t board_width = room.config.board_width;
+        uint32_t board_height = room.config.board_height;
+
+        room.game_id = get_random(room);
+        board_clear(room.board);
+        keyframe_clear(room.keyframe);
+
+        room.game_order.clear();
+        for (uint32_t p = 0; p < room.players.size(); p++)
+            room.game_order.push_back(p);
+        std::sort(room.game_order.begin(), room.game_order.end(), [&room](uint32_t a, uint32_t b) {
+            return room.players[a].name < room.players[b].name;
+        });
+
+        send_new_game(room);
+
+        int n = 0;
+        for (uint32_t p : room.game_order) {
+            player_info_t &player = room.players[p];
+            player.in_game = true;
+            player.number = n;
+            n++;
+            uint32_t x = player.x = (get_random(room) % (board_width) + 0.5);
+            uint32_t y = player.y = (get_random(room) % (board_height) + 0.5);
+            player.direction = get_random(room) % 360;
+            player.fixed_x = fixed_from_cell(x);
+            player.fixed_y = fixed_from_cell(y);
+
+            LOG_DEBUG("room %d: player %d starts at %u %u", room.index, player.number, x, y);
+            if (y > (board_height - 1) || x > (board_width - 1) || board_test_and_set(room.board, x, y)) {
+                handle_player_elimination(room, player);
+                if (!room.game_in_progress)
+                    return;
+            } else {
+                append_pixel(room, player, x, y);
+            }
+        }
+    }
+
+    void do_turn(room_t &room) {
+        uint32_t board_width = room.config.board_width;
+        uint32_t board_height = room.config.board_height;
+        const direction_step_t *steps = direction_steps();
+        const fixed_step_t *fixed_steps = fixed_direction_steps();
+
+        for (uint32_t p : room.game_order) {
+            player_info_t &player = room.players[p];
+            if (player.in_game) {
+                if (player.turn_direction == TURN_RIGHT)
+                    player.direction += room.config.turning_speed;
+                else if (player.turn_direction == TURN_LEFT)
+                    player.direction -= room.config.turning_speed;
+
+                uint32_t old_x, old_y, x, y;
+                if (room.config.fixed_point) {
+                    const fixed_step_t &step = fixed_direction_step(fixed_steps, player.direction);
+                    old_x = fixed_to_cell(player.fixed_x);
+                    old_y = fixed_to_cell(player.fixed_y);
+                    x = fixed_to_cell(player.fixed_x += step.dx);
+                    y = fixed_to_cell(player.fixed_y += step.dy);
+                } else {
+                    const direction_step_t &step = direction_step(steps, player.direction);
+                    old_x = player.x;
+                    old_y = player.y;
+                    x = (player.x += step.dx);
+                    y = (player.y += step.dy);
+                }
+
+                if (x == old_x && y == old_y)
+                    continue;
+
+                LOG_DEBUG("room %d: player %d moves to %u %u", room.index, player.number, x, y);
+                if (y > (board_height - 1) || x > (board_width - 1) || board_test_and_set(room.board, x, y)) {
+                    handle_player_elimination(room, player);
+                    if (!room.game_in_progress)
+                        return;
+                } else {
+                    append_pixel(room, player, x, y);
+                }
+            }
+        }
+    }
+
+    /* Strona klatki, razem najwyżej HISTORY_DATAGRAMS_MAX datagramów: new_game (przy prośbie
+     * od zera), fragmenty od first_fragment, a jeśli zmieścił się ostatni, to jeszcze początek
+     * logu od klatki. Po resztę fragmentów klient przychodzi z KEYFRAME_REQUEST. */
+    size_t keyframe_history(room_t &room, uint32_t first_fragment, bool new_game) {
+        keyframe_t &keyframe = room.keyframe;
+        event_log_t &game_events = room.game_events;
+        uint32_t fragment_count = event_log_count(keyframe.fragments);
+        if (first_fragment >= fragment_count)
+            first_fragment = 0;     // fragmenty innej klatki, klient zacznie zbierać tę od nowa
+        uint32_t page_end = std::min<uint32_t>(fragment_count, first_fragment + HISTORY_DATAGRAMS_MAX - new_game);
+        size_t page = page_end - first_fragment + new_game;
+
+        std::vector<iovec> &iovs = room.history_iovs;
+        if (page_end == fragment_count)
+            event_log_history(game_events, keyframe.event_no, iovs, HISTORY_DATAGRAMS_MAX - page);
+        else
+            iovs.clear();
+        size_t tail = iovs.size();
+        if (new_game)
+            iovs.push_back({(void *) event_log_at(game_events, 0), event_log_bytes(game_events, 0, 1)});
+        for (uint32_t f = first_fragment; f < page_end; f++)
+            iovs.push_back({(void *) event_log_at(keyframe.fragments, f), event_log_bytes(keyframe.fragments, f, f + 1)});
+        // ogon logu na koniec, żeby klient dostał go już po klatce
+        std::rotate(iovs.begin(), iovs.begin() + tail, iovs.end());
+        return iovs.size();
+    }
+
+    void send_history(room_t &room, uint32_t expected_event_no, bool keyframe_capable, sockaddr_in6 client_address) {
+        size_t datagram_count;
+        bool keyframe_request = keyframe_capable && (expected_event_no == 0 || (expected_event_no & KEYFRAME_REQUEST));
+        bool keyframe_useful = keyframe_request && room.game_in_progress &&
+                               event_log_count(room.game_events) >= KEYFRAME_INTERVAL;
+        /* przebudowę przestarzałej klatki zamawia tylko nowy klient, żeby nie zaczynać od nowa
+         * zbieranej już klatki; brakującą zamawia każdy (new_game mógł przyjść na żywo) */
+        if (keyframe_useful && (expected_event_no == 0 || room.keyframe.event_no == 0) &&
+            event_log_count(room.game_events) - room.keyframe.event_no >= KEYFRAME_INTERVAL)
+            room.keyframe.wanted = true;    // do tury starsza klatka z dłuższym ogonem
+
+        if (keyframe_useful && room.keyframe.event_no == 0)
+            return;     // klatka będzie po najbliższej turze, klient ponowi prośbę
+        else if (keyframe_useful && event_log_count(room.keyframe.fragments) != 0)
+            datagram_count = keyframe_history(room, expected_event_no & ~KEYFRAME_REQUEST, expected_event_no == 0);
+        else if (keyframe_request && expected_event_no != 0)
+            // klatki nie ma albo się nie opłaca, klient po new_game potrzebuje eventów od 1
+            datagram_count = event_log_history(room.game_events, 1, room.history_iovs, HISTORY_DATAGRAMS_MAX);
+        else
+            datagram_count = event_log_history(room.game_events, expected_event_no, room.history_iovs,
+                                               HISTORY_DATAGRAMS_MAX);
+        if (datagram_count == 0)
+            return;
+
+        room.history_msgs.resize(datagram_count);
+        size_t bytes = 0;
+        for (size_t i = 0; i < datagram_count; i++) {
+            bytes += room.history_iovs[i].iov_len;
+            msghdr &hdr = room.history_msgs[i].msg_hdr;
+            hdr = {};
+            hdr.msg_name = &client_address;
+            hdr.msg_namelen = sizeof(client_address);
+            hdr.msg_iov = &room.history_iovs[i];
+            hdr.msg_iovlen = 1;
+        }
+
+        room_metric_add(room, &metrics_t::history_datagrams, datagram_count);
+        room_metric_add(room, &metrics_t::history_bytes, bytes);
+        room.send(room, room.history_msgs.data(), datagram_count);
+    }
+
+    /* klient może zacząć albo przestać słuchać grupy, wtedy zmienia się lista odbiorców */
+    void update_multicast(room_t &room, uint32_t slot, bool multicast) {
+        session_t &session = room.sessions.sessions[slot];
+        if (session.multicast != multicast) {
+            session.multicast = multicast;
+            room.fanout.dirty = true;
+        }
+    }
+
+    /* usuwa gracza spoza gry, na jego miejsce trafia ostatni gracz z tablicy */
+    void remove_player(room_t &room, uint32_t p) {
+        if (p + 1 != room.players.size()) {
+            room.players[p] = std::move(room.players.back());
+            if (room.players[p].session != SESSION_NONE)
+                room.sessions.sessions[room.players[p].session].player = p;
+        }
+        room.players.pop_back();
+    }
+
+    void kick_timeouted_clients(room_t &room) {
+        for (timeout_entry_t &entry : room.expired_clients) {
+            if (!timeout_entry_valid(room.sessions, entry))
+                continue;
+            session_t &session = room.sessions.sessions[entry.slot];
+            uint8_t role = session.role;
+            uint32_t p = session.player;
+            LOG_INFO("room %d: disconnecting %s with session %lu", room.index,
+                     role == SESSION_PLAYER ? "player" : "observer", (unsigned long) session.id.session_id);
+            session_erase(room.sessions, entry.slot);
+            if (room.metrics != nullptr)
+                metric_sub(role == SESSION_PLAYER ? room.metrics->players : room.metrics->observers, 1);
+            room.fanout.dirty = true;
+            if (role == SESSION_PLAYER) {
+                // wywalamy gracza
+                player_info_t &player = room.players[p];
+                player.disconnected = true;
+                player.session = SESSION_NONE;
+                if (!room.game_in_progress) {
+                    if (player.ready)
+                        room.ready_players--;
+                    remove_player(room, p);
+                }
+            }
+        }
+        room.expired_clients.clear();
+    }
+
+    uint32_t find_player(room_t &room, std::string_view name) {
+        for (uint32_t p = 0; p < room.players.size(); p++) {
+            if (room.players[p].name == name)
+                return p;
+        }
+        return SESSION_NONE;
+    }
+}
+
+void room_init(room_t &room, int index, int socket, const room_config_t &config, uint32_t seed) {
+    room.index = index;
+    room.socket = socket;
+    room.config = config;
+    room.my_rand = seed;
+    board_init(room.board, config.board_width, config.board_height);
+    // tablice kroków budowane przy starcie, a nie w pierwszej turze
+    direction_steps();
+    fixed_direction_steps();
+    session_table_init(room.sessions, ((uint64_t) std::random_device{}() << 32) | std::random_device{}());
+    timeout_wheel_init(room.timeout_wheel, (uint64_t) CLIENT_TIMEOUT_SECONDS * room.config.rounds_per_sec);
+    room.send = room_sendmmsg;
+}
+
+void room_sendmmsg(room_t &room, mmsghdr *msgs, size_t count) {
+    size_t sent = 0;
+    size_t delivered = 0;
+    while (sent < count) {
+        unsigned int chunk = std::min(count - sent, (size_t) UIO_MAXIOV);
+        int ret = sendmmsg(room.socket, msgs + sent, chunk, 0);
+        if (ret == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;  // bufor gniazda pełny, klienci dopytają o brakujące eventy
+            sent++;     // błąd dotyczy pierwszego komunikatu (np. nieosiągalny adres), pomijamy go
+            continue;
+        }
+        if (room.metrics != nullptr) {
+            uint64_t bytes = 0;
+            for (int i = 0; i < ret; i++)
+                bytes += msgs[sent + i].msg_len;
+            metric_add(room.metrics->bytes_out, bytes);
+        }
+        sent += ret;
+        delivered += ret;
+    }
+    room_metric_add(room, &metrics_t::datagrams_out, delivered);
+    room_metric_add(room, &metrics_t::dropped_sends, count - delivered);
+}
+
+void room_handle_client_msg(room_t &room, client_msg &in_msg, int len, sockaddr_in6 &client_address) {
+    room_metric_add(room, &metrics_t::datagrams_in, 1);
+    room_metric_add(room, &metrics_t::bytes_in, std::max(len, 0));
+    uint8_t turn_direction = in_msg.turn_direction & ~CLIENT_CAPS;
+    bool keyframe_capable = in_msg.turn_direction & CLIENT_CAP_KEYFRAME;
+    bool multicast = in_msg.turn_direction & CLIENT_CAP_MULTICAST;
+    if (len < 13 || turn_direction > 2) {
+        room_metric_add(room, &metrics_t::invalid_msgs, 1);
+        return;   // błąd odbioru, za krótki komunikat lub zły kierunek
+    }
+
+    uint64_t session_id = be64toh(in_msg.session_id);
+    uint32_t expected_event_no = be32toh(in_msg.next_expected_event_no);
+
+    in_port_t client_port = client_address.sin6_port;
+    in6_addr client_addr = client_address.sin6_addr;
+
+    client_id_t client_id = {session_id, client_port, client_addr};
+
+    for (int i = 0; i < len - 13; i++) {
+        uint8_t c = in_msg.player_name[i];
+        if (c < 33 || c > 126) {
+            room_metric_add(room, &metrics_t::invalid_msgs, 1);
+            return;
+        }
+    }
+    std::string_view name((char *) in_msg.player_name, len - 13);
+
+    if (room.recorder != nullptr)
+        record_client_msg(*room.recorder, in_msg, len, client_address);
+
+    LOG_DEBUG("room %d: session %lu name '%.*s' expected event %u direction %d", room.index,
+              (unsigned long) session_id, (int) name.size(), name.data(), expected_event_no, turn_direction);
+
+    uint32_t slot = session_find(room.sessions, client_id);
+
+    if (name.empty()) {
+        /* obserwator */
+        if (slot == SESSION_NONE) {
+            /* nowy obserwator */
+            slot = session_insert(room.sessions, client_id, SESSION_OBSERVER, client_address);
+            room_metric_add(room, &metrics_t::observers, 1);
+            room.fanout.dirty = true;
+
+            send_history(room, expected_event_no, keyframe_capable, client_address);
+            timeout_wheel_add(room.timeout_wheel, room.sessions, slot);
+            update_multicast(room, slot, multicast);
+        }
+        else if (room.sessions.sessions[slot].role == SESSION_OBSERVER) {
+            /* stary obserwator */
+            send_history(room, expected_event_no, keyframe_capable, client_address);
+            timeout_wheel_refresh(room.timeout_wheel, room.sessions, slot);
+            update_multicast(room, slot, multicast);
+        } else {
+            room_metric_add(room, &metrics_t::ignored_msgs, 1);   // sesja gracza bez nazwy
+        }
+        return;
+    }
+
+    uint32_t p;
+    if (slot != SESSION_NONE) {
+        session_t &session = room.sessions.sessions[slot];
+        if (session.role != SESSION_PLAYER || room.players[session.player].name != name) {
+            room_metric_add(room, &metrics_t::ignored_msgs, 1);
+            return;   // ignorujemy, znana sesja nie może ot tak zmienić nazwy gracza
+        }
+        p = session.player;
+    } else {
+        p = find_player(room, name);
+    }
+
+    if (p == SESSION_NONE) {
+        /* nowy gracz */
+        LOG_INFO("room %d: new player %.*s", room.index, (int) name.size(), name.data());
+        p = room.players.size();
+        slot = session_insert(room.sessions, client_id, SESSION_PLAYER, client_address);
+        room.sessions.sessions[slot].player = p;
+        room_metric_add(room, &metrics_t::players, 1);
+        player_info_t new_player_info{std::string(name), false, -1, slot, session_id, false, false,
+                                      0, 0, 0, 0, 0, turn_direction};
+
+        if (new_player_info.turn_direction != 0) {
+            new_player_info.ready = true;
+            room.ready_players++;
+        }
+
+        room.players.push_back(std::move(new_player_info));
+        room.fanout.dirty = true;
+
+        send_history(room, expected_event_no, keyframe_capable, client_address);
+        timeout_wheel_add(room.timeout_wheel, room.sessions, slot);
+        update_multicast(room, slot, multicast);
+    }
+    else {
+        /* znany gracz */
+        player_info_t &player = room.players[p];
+        if (session_id < player.session_id || player.disconnected) {
+            room_metric_add(room, &metrics_t::ignored_msgs, 1);
+            return;
+        }
+
+        if (slot == SESSION_NONE) {
+            // nowa sesja tego samego gracza, być może z innego adresu
+            session_erase(room.sessions, player.session);
+            slot = session_insert(room.sessions, client_id, SESSION_PLAYER, client_address);
+            room.sessions.sessions[slot].player = p;
+            player.session = slot;
+            player.session_id = session_id;
+            room.fanout.dirty = true;
+            timeout_wheel_add(room.timeout_wheel, room.sessions, slot);
+        }
+
+        player.turn_direction = turn_direction;
+        if (!player.ready && turn_direction != 0) {
+            player.ready = true;
+            room.ready_players++;
+        }
+        timeout_wheel_refresh(room.timeout_wheel, room.sessions, slot);
+        update_multicast(room, slot, multicast);
+
+        send_history(room, expected_event_no, keyframe_capable, client_address);
+    }
+}
+
+void room_handle_round(room_t &room, uint64_t exp) {
+    /* Czas przeliczyć turę */
+
+    if (room.recorder != nullptr)
+        record_round(*room.recorder, exp);
+    timeout_wheel_advance(room.timeout_wheel, room.sessions, exp, room.expired_clients);
+    kick_timeouted_clients(room);
+
+    // poprzednia tura czekała na koniec wysyłania, więc nikt już nie wskazuje na stare fragmenty
+    if (room.keyframe.wanted) {
+        keyframe_update(room.keyframe, room.game_events, room.game_id, room.config.board_width);
+        room.keyframe.wanted = false;
+    }
+
+    room_metric_add(room, &metrics_t::rounds, 1);
+    if (room.game_in_progress) {
+        if (room.metrics != nullptr) {
+            uint64_t start = metrics_now_ns();
+            do_turn(room);
+            metric_record(room.metrics->turn_ns, metrics_now_ns() - start);
+        } else {
+            do_turn(room);
+        }
+    } else if (room.ready_players >= 2 && room.ready_players == room.players.size()) {
+        room.game_in_progress = true;
+        room_metric_add(room, &metrics_t::games, 1);
+        init_game(room);
+        LOG_INFO("room %d: game %u started with %zu players", room.index, room.game_id, room.players.size());
+    }
+    flush_tick_batch(room);
+
+    bool any_player_in_game = false;
+    for (player_info_t &player : room.players) {
+        if (player.in_game) {
+            any_player_in_game = true;
+            break;
+        }
+    }
+
+    if (!room.game_in_progress && any_player_in_game) {
+        // gra się właśnie zakończyła
+        LOG_INFO("room %d: game %u over after %u events", room.index, room.game_id,
+                 event_log_count(room.game_events));
+        event_log_clear(room.game_events);
+        keyframe_clear(room.keyframe);
+        room.tick_first_event_no = 0;
+        room.game_order.clear();
+        // od końca, żeby remove_player przenosił na zwolnione miejsce już obejrzanego gracza
+        for (uint32_t p = room.players.size(); p-- > 0;) {
+            player_info_t &player = room.players[p];
+            player.ready = false;
+            player.in_game = false;
+            if (player.disconnected)
+                remove_player(room, p);   // jego sesja została usunięta przy zerwaniu połączenia
+        }
+        room.ready_players = 0;
+    }
+}
@@ -0,0 +1,121 @@
+#ifndef SIK2_ROOM_H
+#define SIK2_ROOM_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "common.h"
+#include "board.h"
+#include "event_log.h"
+#include "session_table.h"
+#include "timeout_wheel.h"
+#include "metrics.h"
+#include "keyframe.h"
+
+#define HISTORY_DATAGRAMS_MAX 64    // na jeden komunikat klienta, reszta przy kolejnym
+
+/* gracz, indeksowany pozycją w room_t::players (zmienia się tylko między grami) */
+struct player_info_t {
+    std::string name;
+    bool disconnected;
+    int16_t number;
+    uint32_t session;       // slot bieżącej sesji gracza, SESSION_NONE po zerwaniu połączenia
+    uint64_t session_id;
+    bool ready;
+    bool in_game;
+    double x;
+    double y;
+    int64_t fixed_x;        // pozycja w trybie stałoprzecinkowym (room_config_t::fixed_point)
+    int64_t fixed_y;
+    int16_t direction;
+    uint8_t turn_direction;
+};
+
+/* parametry gry z linii poleceń, wspólne dla wszystkich pokoi */
+struct room_config_t {
+    int turning_speed;
+    int rounds_per_sec;
+    int board_width;
+    int board_height;
+    bool fixed_point;       // ruch na liczbach stałoprzecinkowych 32.32 zamiast double
+};
+
+/* adresy wszystkich odbiorców eventów na żywo (gracze nie-disconnected
+ * i obserwatorzy), przebudowywane tylko przy zmianie składu */
+struct fanout_t {
+    std::vector<sockaddr_in6> recipients;
+    bool dirty = true;
+    std::vector<mmsghdr> msgs;
+    std::vector<iovec> iovs;
+};
+
+struct room_t;
+struct recorder_t;
+
+/* wysyła komunikaty z gniazda pokoju, dane wskazywane przez komunikaty żyją co najmniej
+ * do następnej tury pokoju */
+typedef void (*room_send_t)(room_t &room, mmsghdr *msgs, size_t count);
+
+/* Jedna niezależna gra z własnym gniazdem. Pokój jest obsługiwany w całości przez jeden
+ * wątek serwera, więc nic tutaj nie wymaga synchronizacji. */
+struct room_t {
+    int index = 0;
+    int socket = -1;
+    room_config_t config{};
+    uint64_t my_rand = 1;
+    uint32_t game_id = 0;
+
+    std::vector<player_info_t> players;     // w kolejności dołączenia
+    std::vector<uint32_t> game_order;       // gracze bieżącej gry posortowani po nazwie
+    uint32_t ready_players = 0;
+    session_table_t sessions;               // sesje graczy i obserwatorów
+    std::vector<timeout_entry_t> expired_clients;
+    board_t board;
+    event_log_t game_events;
+    bool game_in_progress = false;
+    keyframe_t keyframe;                    // budowana w turze po pierwszej prośbie klienta
+
+    /* eventy wygenerowane w trakcie jednej tury trafiają do logu, a na koniec tury
+     * przedział [tick_first_event_no, koniec logu) jest pakowany w datagramy
+     * i wysyłany hurtem zamiast po jednym datagramie na event */
+    uint32_t tick_first_event_no = 0;
+    fanout_t fanout;
+    timeout_wheel_t timeout_wheel;
+
+    /* z multicastem eventy na żywo idą raz na adres grupy, a osobno tylko do klientów
+     * bez CLIENT_CAP_MULTICAST; historia zawsze idzie unicastem */
+    bool multicast = false;
+    sockaddr_in6 multicast_group{};
+
+    /* gotowe kawałki logu dla jednego żądania historii, wysyłane jednym send */
+    std::vector<iovec> history_iovs;
+    std::vector<mmsghdr> history_msgs;
+
+    room_send_t send = nullptr;
+    void *send_ctx = nullptr;   // np. backend io_uring wątku obsługującego pokój
+
+    metrics_t *metrics = nullptr;   // metryki wątku obsługującego pokój, nullptr gdy wyłączone
+    recorder_t *recorder = nullptr; // zapis wejścia pokoju (record.h), nullptr gdy wyłączony
+};
+
+/* przy wyłączonych metrykach kosztuje tylko jedno porównanie */
+inline void room_metric_add(room_t &room, metric_counter_t metrics_t::*counter, uint64_t n) {
+    if (room.metrics != nullptr)
+        metric_add(room.metrics->*counter, n);
+}
+
+void room_init(room_t &room, int index, int socket, const room_config_t &config, uint32_t seed);
+
+/* domyślne room_t::send: sendmmsg na gnieździe pokoju */
+void room_sendmmsg(room_t &room, mmsghdr *msgs, size_t count);
+
+void room_handle_client_msg(room_t &room, client_msg &in_msg, int len, sockaddr_in6 &client_address);
+
+/* exp - liczba tur, które upłynęły od poprzedniego wywołania */
+void room_handle_round(room_t &room, uint64_t exp);
+
+#endif //SIK2_ROOM_H
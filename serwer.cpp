@@ -1,106 +1,70 @@
-#include <iostream>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netdb.h>
 #include <unistd.h>
 #include <vector>
 #include <string>
+#include <stdexcept>
 #include <fcntl.h>
 #include <getopt.h>
 #include <cstring>
-#include <map>
+#include <cstdio>
 #include <algorithm>
-#include <cmath>
-#include <poll.h>
-#include <variant>
+#include <sys/epoll.h>
 #include <sys/timerfd.h>
-#include <set>
+#include <sys/uio.h>
+#include <deque>
+#include <thread>
+#include <memory>
 #include "common.h"
+#include "room.h"
+#include "uring.h"
+#include "log.h"
+#include "metrics.h"
+#include "record.h"
 
 #define DEFAULT_TURNING_SPEED 6
 #define DEFAULT_ROUNDS_PER_SEC 50
 #define DEFAULT_BOARD_WIDTH 640
 #define DEFAULT_BOARD_HEIGHT 480
 
-#define CLIENT_MAX (2 +  MAX_PLAYERS)
-#define MAX_CONSECUTIVE_CLIENT_MSG 100
+#define MAX_CONSECUTIVE_CLIENT_MSG 128
+#define RECV_BATCH_SIZE 32          // komunikatów na jedno wywołanie recvmmsg
+#define EPOLL_EVENTS_MAX 64
+#define EPOLL_ROUND_TIMER UINT64_MAX    // data.u64 timera, gniazda mają indeks pokoju w wątku
+
+#define ROOMS_MAX 1024
+
+#define URING_ENTRIES 256
+#define URING_CQ_ENTRIES 4096
+#define URING_RECV_BUFFERS 256      // potęga dwójki
+#define URING_RECV_BUFFER_SIZE 128  // io_uring_recvmsg_out + sockaddr_in6 + client_msg
+#define URING_OP_BITS 8             // młodsze bity user_data na rodzaj zgłoszenia
 
 namespace {
     uint64_t my_rand;
-    uint32_t game_id;
-    int client_socket;
     int port = DEFAULT_SERVER_PORT;
     int turning_speed = DEFAULT_TURNING_SPEED;
     int rounds_per_sec = DEFAULT_ROUNDS_PER_SEC;
     int board_width = DEFAULT_BOARD_WIDTH;
     int board_height = DEFAULT_BOARD_HEIGHT;
-
-    /* https://stackoverflow.com/questions/31502120/sin-and-cos-give-unexpected-results-for-well-known-angles */
-    inline double degree_to_radian(double d) {
-        return (d / 180.0) * ((double) M_PI);
-    }
-
-    uint32_t get_random() {
-        uint32_t result = (uint32_t) my_rand;
-        my_rand = (my_rand * 279410273) % 4294967291;
-        return result;
-    }
-
-    struct client_id_t {
-        uint64_t session_id;
-        in_port_t port;
-        in6_addr addr;
-    };
-
-    inline bool operator<(const client_id_t& lhs, const client_id_t& rhs)
-    {
-        if (lhs.session_id < rhs.session_id)
-            return true;
-        if (lhs.session_id == rhs.session_id) {
-            if (lhs.port < rhs.port)
-                return true;
-            if (lhs.port == rhs.port) {
-                uint8_t	*lhs_addr = (uint8_t *)&lhs.addr;
-                uint8_t	*rhs_addr = (uint8_t *)&rhs.addr;
-                for (int i = 0; i < sizeof(lhs.addr); i++) {
-                    if (lhs_addr[i] < rhs_addr[i])
-                        return true;
-                }
-            }
-        }
-        return false;
-    }
-
-    struct player_info_t {
-        bool disconnected;
-        int16_t number;
-        client_id_t id;
-        bool ready;
-        bool in_game;
-        double x;
-        double y;
-        int16_t direction;
-        uint8_t turn_direction;
-        sockaddr_in6 address;
-    };
+    bool use_uring = false;
+    bool fixed_point = false;
+    bool async_log = false;
+    int room_count = 1;     // pokój i nasłuchuje na porcie port + i
+    int worker_count = 0;   // 0 - tyle, ile rdzeni (ale nie więcej niż pokoi)
+    int metrics_port = 0;   // 0 - metryki wyłączone
+    std::string record_path;    // plik zapisu, przy wielu pokojach z dopisanym ".<pokój>"
+    std::string replay_path;    // zamiast serwować, odtwarza zapis jednego pokoju
+    std::string multicast_group;    // puste - eventy na żywo tylko unicastem
+    int multicast_port = DEFAULT_MULTICAST_PORT;    // pokój i wysyła do grupy na port multicast_port + i
 
     void get_args(int argc, char *argv[]) {
         int opt;
-        while ((opt = getopt(argc, argv, "p:s:t:v:w:h:")) != -1) {
+        while ((opt = getopt(argc, argv, "p:s:t:v:w:h:ur:j:fam:R:P:g:G:")) != -1) {
             switch (opt) {
                 case 'p':
-                    try {
-                        std::string arg = optarg;
-                        std::size_t pos;
-                        port = std::stoi(arg, &pos);
-                        if (pos < arg.size())
-                            fatal("Trailing characters after number argument");
-                        if (port < 2 || port > 65535)
-                            fatal("invalid port argument");
-                    } catch (std::invalid_argument const &ex) {
-                        fatal("Invalid number argument");
-                    } catch (std::out_of_range const &ex) {
-                        fatal("Number argument out of range");
-                    }
+                    port = parse_number(optarg, 2, 65535, "port");
                     break;
                 case 's':
                     try {
@@ -118,639 +82,551 @@ namespace {
                     }
                     break;
                 case 't':
-                    try {
-                        std::string arg = optarg;
-                        std::size_t pos;
-                        turning_speed = std::stoi(arg, &pos);
-                        if (pos < arg.size())
-                            fatal("Trailing characters after number argument");
-                        if (turning_speed < 1 || turning_speed > 90)
-                            fatal("invalid turning speed argument");
-                    } catch (std::invalid_argument const &ex) {
-                        fatal("Invalid number argument");
-                    } catch (std::out_of_range const &ex) {
-                        fatal("Number argument out of range");
-                    }
+                    turning_speed = parse_number(optarg, 1, 90, "turning speed");
                     break;
                 case 'v':
-                    try {
-                        std::string arg = optarg;
-                        std::size_t pos;
-                        rounds_per_sec = std::stoi(arg, &pos);
-                        if (pos < arg.size())
-                            fatal("Trailing characters after number argument");
-                        if (rounds_per_sec < 1 || rounds_per_sec > 250)
-                            fatal("invalid rounds per second argument");
-                    } catch (std::invalid_argument const &ex) {
-                        fatal("Invalid number argument");
-                    } catch (std::out_of_range const &ex) {
-                        fatal("Number argument out of range");
-                    }
+                    rounds_per_sec = parse_number(optarg, 1, 250, "rounds per second");
                     break;
                 case 'w':
-                    try {
-                        std::string arg = optarg;
-                        std::size_t pos;
-                        board_width = std::stoi(arg, &pos);
-                        if (pos < arg.size())
-                            fatal("Trailing characters after number argument");
-                        if (board_width < BOARD_WIDTH_MIN || board_width > BOARD_WIDTH_MAX)
-                            fatal("invalid board width argument");
-                    } catch (std::invalid_argument const &ex) {
-                        fatal("Invalid number argument");
-                    } catch (std::out_of_range const &ex) {
-                        fatal("Number argument out of range");
-                    }
+                    board_width = parse_number(optarg, BOARD_WIDTH_MIN, BOARD_WIDTH_MAX, "board width");
                     break;
                 case 'h':
-                    try {
-                        std::string arg = optarg;
-                        std::size_t pos;
-                        board_height = std::stoi(arg, &pos);
-                        if (pos < arg.size())
-                            fatal("Trailing characters after number argument");
-                        if (board_height < BOARD_HEIGHT_MIN || board_height > BOARD_HEIGHT_MAX)
-                            fatal("invalid board height argument");
-                    } catch (std::invalid_argument const &ex) {
-                        fatal("Invalid number argument");
-                    } catch (std::out_of_range const &ex) {
-                        fatal("Number argument out of range");
-                    }
+                    board_height = parse_number(optarg, BOARD_HEIGHT_MIN, BOARD_HEIGHT_MAX, "board height");
+                    break;
+                case 'u':
+                    use_uring = true;
+                    break;
+                case 'f':
+                    fixed_point = true;
+                    break;
+                case 'a':
+                    async_log = true;
+                    break;
+                case 'r':
+                    room_count = parse_number(optarg, 1, ROOMS_MAX, "room count");
+                    break;
+                case 'j':
+                    worker_count = parse_number(optarg, 1, ROOMS_MAX, "worker count");
+                    break;
+                case 'm':
+                    metrics_port = parse_number(optarg, 1, 65535, "metrics port");
+                    break;
+                case 'R':
+                    record_path = optarg;
+                    break;
+                case 'P':
+                    replay_path = optarg;
+                    break;
+                case 'g':
+                    multicast_group = optarg;
+                    break;
+                case 'G':
+                    multicast_port = parse_number(optarg, 1, 65535, "multicast port");
                     break;
                 default:
-                    fatal("Arguments: [-p n] [-s n] [-t n] [-v n] [-w n] [-h n]\n");
+                    fatal("Arguments: [-p n] [-s n] [-t n] [-v n] [-w n] [-h n] [-u] [-r n] [-j n] [-f] [-a] [-m n] [-R file] [-P file] [-g group] [-G n]\n");
             }
         }
 
         if (argc - optind != 0)
-            fatal("Arguments: [-p n] [-s n] [-t n] [-v n] [-w n] [-h n]\n");
-
-    }
+            fatal("Arguments: [-p n] [-s n] [-t n] [-v n] [-w n] [-h n] [-u] [-r n] [-j n] [-f] [-a] [-m n] [-R file] [-P file] [-g group] [-G n]\n");
 
-    bool check_game_over(std::map<std::string, player_info_t> &players) {
-        int alive_players = 0;
-        for (auto &pair2: players) {
-            if (pair2.second.in_game)
-                alive_players++;
-        }
-
-        return alive_players == 1;
+        if (port + room_count - 1 > 65535)
+            fatal("too many rooms for the given port");
+        if (!multicast_group.empty() && multicast_port + room_count - 1 > 65535)
+            fatal("too many rooms for the given multicast port");
     }
 
-    void send_to_all(std::map<std::string, player_info_t> &players,
-                     std::set<client_id_t> &observers,
-                     char *event, size_t size) {
-        std::cout << "SENDING!!!\n";
-
-        uint32_t sent_game_id = be32toh(*(uint32_t *) event);
-        uint32_t len = be32toh(*(uint32_t *) (event + 4));
-        uint32_t event_no = be32toh(*(uint32_t *) (event + 8));
-        uint8_t event_type = *(uint8_t *) (event + 12);
-        std::cout << "game id (sent, actual):" << sent_game_id << " " << game_id << std::endl;
-        std::cout << "len, number, type: " << len << ", " << event_no << ", " << (int) event_type << std::endl;
-        uint32_t sent_crc32 = be32toh(*(uint32_t *) (event + len + 8));
-        uint32_t my_crc32 = crc32buf(event, len + 8);
-
-        std::cout << "crc32(sent, mine):" << sent_crc32 << " " << my_crc32 << std::endl;
-
-        for (auto &pair: players) {
-            player_info_t &client_player = pair.second;
-            if (client_player.disconnected)
-                continue;
-
-            std::cout << "Sending to player\n";
-            sendto(client_socket, event, size, 0,
-                   (sockaddr *) &client_player.address, sizeof(client_player.address));
-        }
-        for (auto &observer: observers) {
-            auto addr = observer.addr;
-            std::cout << "Sending to observer\n";
-            sendto(client_socket, event, size, 0,
-                   (sockaddr *) &(addr), sizeof(addr));
-        }
-    }
+    /* Wątek serwera z pokojami, które obsługuje na wyłączność: własna pętla zdarzeń
+     * (epoll albo io_uring) na gniazdach tych pokoi i jeden timer tury dla nich wszystkich. */
+    struct worker_t {
+        std::vector<room_t> rooms;
+        bool use_uring = false;
+        std::unique_ptr<metrics_t> metrics;     // tylko z -m
+        std::thread thread;
+    };
 
-    void handle_player_elimination(player_info_t &player, std::map<std::string, player_info_t> &players,
-                                   bool &game_in_progress, std::set<client_id_t> &observers,
-                                   std::vector<std::variant<event_new_game, event_pixel, event_player_eliminated, event_game_over>> &game_events) {
-        player.in_game = false;
-        event_player_eliminated event_elimination{htobe32(game_id),
-                                                  htobe32((uint32_t) sizeof(event_player_eliminated) - 12),
-                                                  htobe32((uint32_t) game_events.size()),
-                                                  TYPE_PLAYER_ELIMINATED, (uint8_t)player.number, 0};
-        event_elimination.crc32 = htobe32(crc32buf((char *) &event_elimination + 4, sizeof(event_player_eliminated) - 8));
-        game_events.emplace_back(event_elimination);
-
-        send_to_all(players, observers, (char *) &event_elimination, sizeof(event_elimination));
-
-        if (check_game_over(players)) {
-            game_in_progress = false;
-            event_game_over event_game_over{htobe32(game_id),
-                                            htobe32((uint32_t) sizeof(event_game_over) - 12),
-                                            htobe32((uint32_t) game_events.size()),
-                                            TYPE_GAME_OVER, 0};
-            event_game_over.crc32 = htobe32(crc32buf((char *) &event_game_over + 4, sizeof(event_game_over) - 8));
-            game_events.emplace_back(event_game_over);
-
-            send_to_all(players, observers, (char *) &event_game_over, sizeof(event_game_over));
-        }
+    /* ziarno pokoju index, w zakresie [1, 2^32 - 1]; pokój 0 dostaje ziarno z -s */
+    uint32_t room_seed(uint64_t seed, int index) {
+        return (uint32_t) ((seed - 1 + index) % 4294967295 + 1);
     }
 
-    void send_new_game(std::map<std::string, player_info_t> &players,
-                       std::set<client_id_t> &observers,
-                       std::vector<std::variant<event_new_game, event_pixel, event_player_eliminated, event_game_over>> &game_events) {
-        std::cout << "SENDING NEW GAME\n";
-        std::string player_list;
-        static char placeholder = (char) 246; // placeholder char do zmiany na \0
-
-        for (auto &pair : players) {
-            std::string name = pair.first;
-            player_list += name + placeholder;
-        }
-        uint32_t player_list_size = player_list.size();
-
-        char *player_list_data = player_list.data();
-        for (int i = 0; i < player_list_size; i++) {
-            if (player_list_data[i] == placeholder)
-                player_list_data[i] = '\0';
-        }
+    int create_room_socket(int room_port) {
+        int sock = socket(PF_INET6, SOCK_DGRAM, 0);
+        if (sock == -1)
+            syserr("socket");
 
-        uint32_t len = 13 + player_list_size;
+        int on = 1;
+        if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR,
+                       (char *) &on, sizeof(on)) < 0)
+            syserr("setsockopt");
 
-        event_new_game event_new_game{htobe32(game_id), htobe32(len),
-                                      htobe32(game_events.size()), TYPE_NEW_GAME,
-                                      htobe32(board_width), htobe32(board_height), 0};
+        if (fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK) == -1)
+            syserr("fcntl");
 
-        for (int i = 0; i < player_list_size; i++)
-            event_new_game.list_and_crc[i] = player_list_data[i];
+        sockaddr_in6 serveraddr{};
+        serveraddr.sin6_family = AF_INET6;
+        serveraddr.sin6_port = htons(room_port);
+        serveraddr.sin6_addr = in6addr_any;
 
-        uint32_t crc32 = htobe32(crc32buf((char *) &event_new_game + 4, len + 4));
+        if (bind(sock, (struct sockaddr *) &serveraddr,
+                 (socklen_t) sizeof(serveraddr)) == -1)
+            syserr("bind serveraddr");
+        return sock;
+    }
 
-        memcpy((char *) &event_new_game + len + 8, &crc32, sizeof(uint32_t));
+    /* adres grupy dla gniazd pokoi (AF_INET6), grupa IPv4 jako adres zmapowany ::ffff:a.b.c.d */
+    sockaddr_in6 resolve_multicast_group(int group_port) {
+        addrinfo addr_hints{};
+        addr_hints.ai_family = AF_INET6;
+        addr_hints.ai_socktype = SOCK_DGRAM;
+        addr_hints.ai_flags = AI_NUMERICHOST | AI_V4MAPPED;
+        addrinfo *addr_result;
+        if (getaddrinfo(multicast_group.c_str(), std::to_string(group_port).c_str(), &addr_hints, &addr_result) != 0)
+            fatal("invalid multicast group argument");
+        sockaddr_in6 group = *(sockaddr_in6 *) addr_result->ai_addr;
+        freeaddrinfo(addr_result);
+
+        const in6_addr &addr = group.sin6_addr;
+        if (!IN6_IS_ADDR_MULTICAST(&addr) && !(IN6_IS_ADDR_V4MAPPED(&addr) && (addr.s6_addr[12] & 0xf0) == 0xe0))
+            fatal("%s is not a multicast address", multicast_group.c_str());
+        return group;
+    }
 
-        game_events.emplace_back(event_new_game);
+    /* pętla zwrotna włączona, żeby odbiorcy na tym samym komputerze (i testy na lo) też
+     * dostawali grupę; TTL/hop limit zostaje domyślny (1), czyli tylko sieć lokalna */
+    void enable_multicast_loop(int sock) {
+        int on = 1;
+        if (setsockopt(sock, IPPROTO_IPV6, IPV6_MULTICAST_LOOP, &on, sizeof(on)) < 0)
+            syserr("setsockopt IPV6_MULTICAST_LOOP");
+        if (setsockopt(sock, IPPROTO_IP, IP_MULTICAST_LOOP, &on, sizeof(on)) < 0)
+            syserr("setsockopt IP_MULTICAST_LOOP");
+    }
 
-        send_to_all(players, observers, (char *) &event_new_game, len + 12);
+    inline uint64_t timespec_ns(const timespec &ts) {
+        return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
     }
 
+    /* bufory na komunikaty odbierane hurtem przez recvmmsg, przygotowane raz na wątek */
+    struct recv_batch_t {
+        client_msg in_msgs[RECV_BATCH_SIZE];
+        sockaddr_in6 client_addresses[RECV_BATCH_SIZE];
+        iovec in_iovs[RECV_BATCH_SIZE];
+        mmsghdr in_hdrs[RECV_BATCH_SIZE];
+    };
 
-    void init_game(std::map<std::string, player_info_t> &players,
-                   std::set<client_id_t> &observers, std::vector<bool> &board,
-                   std::vector<std::variant<event_new_game, event_pixel, event_player_eliminated, event_game_over>> &game_events,
-                   bool &game_in_progress) {
-        game_id = get_random();
-        for (int i = 0; i < board.size(); i++)
-            board[i] = NOT_EATEN;
-
-        send_new_game(players, observers, game_events);
-
-        int n = 0;
-        for (auto &pair: players) {
-            player_info_t &player = pair.second;
-            player.in_game = true;
-            player.number = n;
-            std::cout << "ruch gracza " << player.number << std::endl;
-            n++;
-            uint32_t x = player.x = (get_random() % (board_width) + 0.5);
-            uint32_t y = player.y = (get_random() % (board_height) + 0.5);
-            player.direction = get_random() % 360;
-
-            std::cout << x << " " << y << "  " << y * board_width + x << " <> " << board.size() << std::endl;
-            if (board[y * board_width + x] == EATEN || y > (board_height - 1) || x > (board_width - 1)) {
-                std::cout << "ELIMINATED\n";
-                handle_player_elimination(player, players, game_in_progress, observers, game_events);
-                if (!game_in_progress)
-                    return;
-            } else {
-                std::cout << "PIXEL\n";
-                board[y * board_width + x] = EATEN;
-                event_pixel event_pixel{htobe32(game_id),
-                                        htobe32(sizeof(event_pixel) - 12),
-                                        htobe32((uint32_t) game_events.size()),
-                                        TYPE_PIXEL, (uint8_t) player.number,
-                                        htobe32(x), htobe32(y), 0};
-                event_pixel.crc32 = htobe32(crc32buf((char *) &event_pixel + 4, sizeof(event_pixel) - 8));
-                game_events.emplace_back(event_pixel);
-
-                send_to_all(players, observers, (char *) &event_pixel, sizeof(event_pixel));
-            }
+    void init_recv_batch(recv_batch_t &batch) {
+        for (int i = 0; i < RECV_BATCH_SIZE; i++) {
+            batch.in_iovs[i] = {&batch.in_msgs[i], sizeof(client_msg)};
+            batch.in_hdrs[i].msg_hdr = {};
+            batch.in_hdrs[i].msg_hdr.msg_name = &batch.client_addresses[i];
+            batch.in_hdrs[i].msg_hdr.msg_iov = &batch.in_iovs[i];
+            batch.in_hdrs[i].msg_hdr.msg_iovlen = 1;
         }
     }
 
-    void do_turn(std::map<std::string, player_info_t> &players,
-                 std::set<client_id_t> &observers, std::vector<bool> &board,
-                 std::vector<std::variant<event_new_game, event_pixel, event_player_eliminated, event_game_over>> &game_events,
-                 bool &game_in_progess) {
-
-        for (auto &pair: players) {
-            player_info_t &player = pair.second;
-            if (player.in_game) {
-                std::cout << "ruch gracza " << player.number << std::endl;
-                if (player.turn_direction == TURN_RIGHT)
-                    player.direction += turning_speed;
-                else if (player.turn_direction == TURN_LEFT)
-                    player.direction -= turning_speed;
-
-                uint32_t old_x = player.x;
-                uint32_t old_y = player.y;
-
-                double direction = degree_to_radian(player.direction);
-                uint32_t x = (player.x += std::cos(direction));
-                uint32_t y = (player.y += std::sin(direction));
-
-                if (x == old_x && y == old_y)
-                    continue;
-
-                std::cout << x << " " << y << "  " << y * board_width + x << " <> " << board.size() << std::endl;
-                if (y > (board_height - 1) || x > (board_width - 1) || board[y * board_width + x] == EATEN) {
-                    handle_player_elimination(player, players, game_in_progess, observers, game_events);
-                    if (!game_in_progess)
-                        return;
-                } else {
-                    board[y * board_width + x] = EATEN;
-                    event_pixel event_pixel{htobe32(game_id),
-                                            htobe32(sizeof(event_pixel) - 12),
-                                            htobe32((uint32_t) game_events.size()),
-                                            TYPE_PIXEL, (uint8_t) player.number,
-                                            htobe32(x), htobe32(y), 0};
-
-                    event_pixel.crc32 = htobe32(crc32buf((char *) &event_pixel + 4, sizeof(event_pixel) - 8));
-                    game_events.emplace_back(event_pixel);
-
-                    send_to_all(players, observers, (char *) &event_pixel, sizeof(event_pixel));
-                }
-            }
-        }
-    }
+    /* odbiera komunikaty z gniazda pokoju, zwraca false, jeśli gniazdo zostało opróżnione */
+    bool receive_client_msgs(room_t &room, recv_batch_t &batch) {
+        /* limit a nie while(true) żeby serwer nie był sparaliżowany np
+         * masą połączęń i odłączeń obserwatorów którym trzeba wysłać sporą historię */
+        for (int t = 0; t < MAX_CONSECUTIVE_CLIENT_MSG; t += RECV_BATCH_SIZE) {
+            for (int i = 0; i < RECV_BATCH_SIZE; i++)
+                batch.in_hdrs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in6);
 
-    void update_timer(pollfd &client) {
-        itimerspec new_value{};
-        timespec now{};
-        if (clock_gettime(CLOCK_REALTIME, &now) == -1)
-            syserr("clock_gettime");
+            int ret = recvmmsg(room.socket, batch.in_hdrs, RECV_BATCH_SIZE, MSG_DONTWAIT, NULL);
 
-        new_value.it_value.tv_sec = now.tv_sec + CLIENT_TIMEOUT_SECONDS;
-        new_value.it_value.tv_nsec = now.tv_nsec;
-        new_value.it_interval.tv_sec = CLIENT_TIMEOUT_SECONDS;
-        new_value.it_interval.tv_nsec = 0;
+            if (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                return false;   // brak komunikatów do odebrania, czekamy na kolejne zbocze
 
-        if (timerfd_settime(client.fd, TFD_TIMER_ABSTIME, &new_value, NULL) == -1)
-            syserr("timerfd_settime update");
+            for (int i = 0; i < ret; i++)
+                room_handle_client_msg(room, batch.in_msgs[i], (int) batch.in_hdrs[i].msg_len,
+                                       batch.client_addresses[i]);
 
-        uint64_t exp;
-        if (client.revents & POLLIN) {
-            client.revents = 0;
-            read(client.fd, &exp, sizeof(uint64_t));
+            if (ret < RECV_BATCH_SIZE)
+                return false;   // kolejka gniazda opróżniona, nowy datagram da nowe zbocze
         }
+        return true;
     }
 
+    void run_epoll_loop(worker_t &worker) {
+        /*
+         * epoll (edge-triggered) na gniazdach pokoi do odbierania i wysyłania komunikatów
+         * oraz na timerze rundy, który napędza też koła czasowe zrywania połączeń
+        */
+        std::vector<room_t> &rooms = worker.rooms;
+        int round_timer;
+        create_timer(round_timer, TIMER_ROUND, rooms[0].config.rounds_per_sec);
+
+        int epoll_fd = epoll_create1(0);
+        if (epoll_fd == -1)
+            syserr("epoll_create1");
+
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLET;
+        for (size_t r = 0; r < rooms.size(); r++) {
+            ev.data.u64 = r;
+            if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, rooms[r].socket, &ev) == -1)
+                syserr("epoll_ctl socket");
+        }
+        ev.data.u64 = EPOLL_ROUND_TIMER;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, round_timer, &ev) == -1)
+            syserr("epoll_ctl timer");
 
-    void send_history(uint32_t expected_event_no, sockaddr_in6 client_address, std::vector<int8_t> &buf_vector,
-                      std::vector<std::variant<event_new_game, event_pixel, event_player_eliminated, event_game_over>> &game_events) {
-        static char event_buf[sizeof(event_new_game)];  // na jeden event, new_game to największy możliwy
-
-        if (expected_event_no < game_events.size()) {
-            std::cout << "SENDING HISTORY!!!\n";
-            int total_size = 0;
-            int size = 0;
+        epoll_event ready_events[EPOLL_EVENTS_MAX];
+        // przy edge-triggered musimy sami pamiętać, w których gniazdach zostały komunikaty
+        std::vector<char> socket_readable(rooms.size(), false);
+        size_t readable_count = 0;
 
-            for (int i = expected_event_no; i < game_events.size(); i++) {
-                auto event_variant = game_events[i];
-                if (auto new_game_p = std::get_if<event_new_game>(&event_variant)) {
-                    event_new_game new_game = *new_game_p;
-                    uint32_t len = htobe32(new_game.len);
-                    memcpy(event_buf, (const char *) &new_game, len + 12);
-                    size = (int) len + 12;
-                }
-                else if (auto pixel_p = std::get_if<event_pixel>(&event_variant)) {
-                    event_pixel pixel = *pixel_p;
-                    memcpy(event_buf, (const char *) &pixel, sizeof(pixel));
-                    size = sizeof(event_pixel);
-                }
-                else if (auto elim_p = std::get_if<event_player_eliminated>(&event_variant)) {
-                    event_player_eliminated elim = *elim_p;
-                    memcpy(event_buf, (const char *) &elim, sizeof(elim));
-                    size = sizeof(event_player_eliminated);
-                }
-                else if (auto game_over_p = std::get_if<event_game_over>(&event_variant)) {
-                    event_game_over game_over = *game_over_p;
-                    memcpy(event_buf, (const char *) &game_over, sizeof(game_over));
-                    size = sizeof(event_game_over);
-                }
+        recv_batch_t batch{};
+        init_recv_batch(batch);
 
-                if (total_size + size <= DATAGRAM_MAX_SIZE) {
-                    memcpy(buf_vector.data() + total_size, event_buf, size);
-                    total_size += size;
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "EndlessLoop"
+        while (true) { // pracujemy aż coś się mocno nie zepsuje
+            // jeśli w gniazdach zostały nieodebrane komunikaty, tylko sprawdzamy zdarzenia
+            int ret = epoll_wait(epoll_fd, ready_events, EPOLL_EVENTS_MAX, readable_count > 0 ? 0 : -1);
+
+            if (ret < 0 || (ret == 0 && readable_count == 0)) // zawsze powinien nas budzić co najmniej timer tury
+                syserr("epoll_wait or timer");
+
+            bool round_timer_expired = false;
+            for (int i = 0; i < ret; i++) {
+                uint64_t r = ready_events[i].data.u64;
+                if (r == EPOLL_ROUND_TIMER) {
+                    round_timer_expired = true;
+                } else if (!socket_readable[r]) {
+                    socket_readable[r] = true;
+                    readable_count++;
                 }
-                else {
-                    sendto(client_socket, (char *) buf_vector.data(), total_size, 0,
-                           (sockaddr *) (&client_address), sizeof(client_address));
+            }
 
-                    send_history(i, client_address, buf_vector, game_events);
+            /* Komunikaty od klientów, po porcji z każdego pokoju */
+            for (size_t r = 0; r < rooms.size() && readable_count > 0; r++) {
+                if (socket_readable[r] && !receive_client_msgs(rooms[r], batch)) {
+                    socket_readable[r] = false;
+                    readable_count--;
                 }
             }
 
-            uint32_t len = be32toh(*(uint32_t *) (buf_vector.data() + 4));
-            uint32_t event_no = be32toh(*(uint32_t *) (buf_vector.data() + 8));
-            uint8_t event_type = *(uint8_t *) (buf_vector.data() + 12);
-            std::cout << "len, number, type: " << len << ", " << event_no << ", " << (int) event_type << std::endl;
-            uint32_t sent_crc32 = be32toh(*(uint32_t *) (buf_vector.data() + len + 8));
-            std::cout << "crc32:" << sent_crc32 << std::endl;
-
-            sendto(client_socket, (char *) buf_vector.data(), total_size, 0,
-                   (sockaddr *) (&client_address), sizeof(client_address));
-        }
-    }
-
-    void kick_timeouted_clients(pollfd *poll_arr, std::map<std::string, player_info_t> &players,
-                                std::set<client_id_t> &observers,
-                                std::map<client_id_t, uint16_t> &client_poll_position,
-                                std::map<client_id_t, std::string> &player_ids,
-                                bool game_in_progress, int &ready_players) {
-        for (int i = 2; i < CLIENT_MAX; i++) {
-            if (poll_arr[i].revents & POLLIN) {
+            if (round_timer_expired) {
                 uint64_t exp;
-                read(poll_arr[i].fd, &exp, sizeof(uint64_t));
-                poll_arr[i].revents = 0;
-                std::cout << "disconnecting client\n";
-                poll_arr[i].fd = -1;
-                client_id_t client_id;
-                for (std::pair pair : client_poll_position) {
-                    if (pair.second == i) {
-                        std::cout << "znaleziono delikwenta\n";
-                        client_id = pair.first;
-                        break;
-                    }
+                read(round_timer, &exp, sizeof(uint64_t));
+                if (worker.metrics != nullptr) {
+                    // od ostatniego terminu minął okres timera pomniejszony o czas do następnego
+                    itimerspec remaining{};
+                    timerfd_gettime(round_timer, &remaining);
+                    metric_record(worker.metrics->round_lateness_ns,
+                                  timespec_ns(remaining.it_interval) - timespec_ns(remaining.it_value));
                 }
-                if (observers.find(client_id) != observers.end()) {
-                    // wywalamy observera
-                    observers.erase(client_id);
-                } else {
-                    // wywalamy gracza
-                    std::string name = player_ids[client_id];
-                    player_info_t &player = players[name];
-                    player.disconnected = true;
-                    if (!game_in_progress) {
-                        if (player.ready)
-                            ready_players--;
-                        player_ids.erase(client_id);
-                        players.erase(name);
-                    }
-                }
-                client_poll_position.erase(client_id);
+                for (room_t &room : rooms)
+                    room_handle_round(room, exp);
             }
         }
+#pragma clang diagnostic pop
     }
 
-}
-
-int main(int argc, char *argv[]) {
-    my_rand = (uint32_t)time(NULL);
-
-    get_args(argc, argv);
+    /* Pętla na io_uring: multishot recvmsg z pierścieniem buforów (wspólnym dla pokoi wątku),
+     * wysyłanie przez zgłoszenia sendmsg przekazywane jądru hurtem raz na obrót pętli, timer
+     * tury jako zgłoszenie timeout z bezwzględnym terminem. user_data to rodzaj zgłoszenia
+     * w młodszych 8 bitach i indeks pokoju w wątku w pozostałych. */
+    enum : uint64_t {
+        URING_RECV = 1,
+        URING_ROUND,
+        URING_SEND,
+    };
 
-    std::map<std::string, player_info_t> players; // mapujemy nazwę do informacji
-    int ready_players = 0;
-    //std::map<uint64_t, sockaddr_in6> observers; // session id do adresu
-    std::set<client_id_t> observers;
-    std::map<client_id_t, uint16_t> client_poll_position; // pun not intended, session id do pozycji w pollu
-    std::map<client_id_t, std::string> player_ids; // session id do nazwy gracza
-    std::vector<bool> board;
-    board.resize(board_width * board_height);
-    std::vector<std::variant<event_new_game, event_pixel, event_player_eliminated, event_game_over>> game_events;
-    bool game_in_progress = false;
-
-    /*
-     * poll_arr[0] na odbieranie i wysyłanie komunikatów
-     * poll_arr[1] na timer rundy
-     * pozostałe na timery klientów (do zrywania połączeń przy braku komunikacji przez 2s)
-    */
-
-    pollfd poll_arr[CLIENT_MAX];
-    for (int i = 0; i < CLIENT_MAX; i++) {
-        poll_arr[i].fd = -1;
-        poll_arr[i].events = POLLIN;
-        poll_arr[i].revents = 0;
+    inline uint64_t uring_user_data(uint64_t op, size_t room) {
+        return ((uint64_t) room << URING_OP_BITS) | op;
     }
 
-    sockaddr_in6 serveraddr{};
-    sockaddr_in6 client_address{};
-    create_timer(poll_arr[1].fd, TIMER_ROUND, rounds_per_sec);
-
-    client_socket = poll_arr[0].fd = socket(PF_INET6, SOCK_DGRAM, 0);
-    if (poll_arr[0].fd == -1)
-        syserr("socket");
-
-    int on = 1;
-    if (setsockopt(poll_arr[0].fd, SOL_SOCKET, SO_REUSEADDR,
-                   (char *) &on, sizeof(on)) < 0)
-        syserr("setsockopt");
-
-    if (fcntl(poll_arr[0].fd, F_SETFL, fcntl(poll_arr[0].fd, F_GETFL, 0) | O_NONBLOCK) == -1)
-        syserr("fcntl");
-
-    memset(&serveraddr, 0, sizeof(serveraddr));
-    serveraddr.sin6_family = AF_INET6;
-    serveraddr.sin6_port = htons(port);
-    serveraddr.sin6_addr = in6addr_any;
-
-    if (bind(poll_arr[0].fd, (struct sockaddr *) &serveraddr,
-             (socklen_t) sizeof(serveraddr)) == -1)
-        syserr("bind serveraddr");
-
-    client_msg in_msg{};
-    std::vector<int8_t >buf(DATAGRAM_MAX_SIZE);
+    struct uring_send_t {
+        msghdr hdr;
+        iovec iov;
+        sockaddr_in6 addr;
+    };
 
-    if (buf.data() == NULL)
-        syserr("vector alloc");
+    struct uring_backend_t {
+        uring_t ring;
+        uring_buf_ring_t bufs;
+        msghdr recv_hdr;
+        __kernel_timespec round_deadline;
+        uint64_t round_interval_ns;
+        /* Nagłówki wysłanych komunikatów i dane, na które wskazują (log eventów), muszą
+         * żyć do zakończenia wysyłania, więc turę liczymy dopiero gdy nic nie jest w locie.
+         * Od upływu terminu tury odebrane komunikaty czekają w deferred_recvs, żeby ich
+         * odpowiedzi nie dokładały wysyłania i nie odsuwały tury bez końca. */
+        std::deque<uring_send_t> sends;
+        size_t sends_in_flight = 0;
+        std::vector<io_uring_cqe> deferred_recvs;
+    };
 
-#pragma clang diagnostic push
-#pragma ide diagnostic ignored "EndlessLoop"
-    while (true) { // pracujemy aż coś się mocno nie zepsuje
-        int ret = poll(poll_arr, CLIENT_MAX, -1);
-
-        if (ret <= 0) // zawsze powinien nas budzić co najmniej timer tury
-            syserr("poll or timer");
-
-        if (poll_arr[0].revents & POLLIN) {
-            /* Komunikat od klienta */
-            std::cout << "Komunikat od klienta\n";
-
-            /* pętla for a nie while(true) żeby serwer nie był sparaliżowany np
-             * masą połączęń i odłączeń obserwatorów którym trzeba wysłać sporą historię */
-            for (int t = 0; t < MAX_CONSECUTIVE_CLIENT_MSG; t++) {
-                socklen_t rcva_len = (socklen_t) sizeof(client_address);
-                memset(&in_msg, 0, sizeof(client_msg));
-                ret = recvfrom(poll_arr[0].fd, (char *) &in_msg, sizeof(client_msg), 0,
-                               (struct sockaddr *) &client_address, &rcva_len);
-
-                if (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-                    // brak komunikatów do odebrania więc zerujemy revents
-                    poll_arr[0].revents = 0;
-                    break;
-                }
+    /* room_t::send pokoi obsługiwanych przez io_uring */
+    void uring_queue_sends(room_t &room, mmsghdr *msgs, size_t count) {
+        auto &backend = *static_cast<uring_backend_t *>(room.send_ctx);
+        for (size_t i = 0; i < count; i++) {
+            io_uring_sqe *sqe = uring_get_sqe(backend.ring);
+            if (sqe == NULL) {
+                // jak przy pełnym buforze gniazda: reszta przepada, klienci dopytają o historię
+                room_metric_add(room, &metrics_t::dropped_sends, count - i);
+                return;
+            }
+            msghdr &src = msgs[i].msg_hdr;
+            uring_send_t &send = backend.sends.emplace_back();
+            send.iov = src.msg_iov[0];
+            memcpy(&send.addr, src.msg_name, sizeof(send.addr));
+            send.hdr = {};
+            send.hdr.msg_name = &send.addr;
+            send.hdr.msg_namelen = sizeof(send.addr);
+            send.hdr.msg_iov = &send.iov;
+            send.hdr.msg_iovlen = 1;
+
+            sqe->opcode = IORING_OP_SENDMSG;
+            sqe->fd = room.socket;
+            sqe->addr = (uint64_t) &send.hdr;
+            sqe->len = 1;
+            sqe->user_data = URING_SEND;
+            backend.sends_in_flight++;
+        }
+    }
 
-                if (in_msg.turn_direction > 2)
-                    continue;
+    /* zgłoszenie, bez którego pętla nie może działać dalej */
+    io_uring_sqe *uring_get_sqe_or_die(uring_backend_t &backend) {
+        io_uring_sqe *sqe = uring_get_sqe(backend.ring);
+        if (sqe == NULL)
+            fatal("io_uring submission queue full");
+        return sqe;
+    }
 
-                uint64_t session_id = be64toh(in_msg.session_id);
-                uint32_t expected_event_no = be32toh(in_msg.next_expected_event_no);
-                uint8_t turn_direction = in_msg.turn_direction;
+    void uring_arm_recv(uring_backend_t &backend, room_t &room, size_t r) {
+        io_uring_sqe *sqe = uring_get_sqe_or_die(backend);
+        sqe->opcode = IORING_OP_RECVMSG;
+        sqe->fd = room.socket;
+        sqe->addr = (uint64_t) &backend.recv_hdr;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = backend.bufs.bgid;
+        sqe->user_data = uring_user_data(URING_RECV, r);
+    }
 
-                in_port_t client_port = client_address.sin6_port;
-                in6_addr client_addr = client_address.sin6_addr;
+    void uring_arm_round_timer(uring_backend_t &backend) {
+        io_uring_sqe *sqe = uring_get_sqe_or_die(backend);
+        sqe->opcode = IORING_OP_TIMEOUT;
+        sqe->addr = (uint64_t) &backend.round_deadline;
+        sqe->len = 1;
+        sqe->timeout_flags = IORING_TIMEOUT_ABS;
+        sqe->user_data = URING_ROUND;
+    }
 
-                client_id_t client_id = {session_id, client_port, client_addr};
+    /* przesuwa termin tury za bieżącą chwilę, zwraca liczbę minionych tur */
+    uint64_t uring_next_round_deadline(uring_backend_t &backend) {
+        timespec now{};
+        if (clock_gettime(CLOCK_MONOTONIC, &now) == -1)
+            syserr("clock_gettime");
 
-                std::cout << "id: " << session_id << " expected event: " << expected_event_no << " direction: " << (int)turn_direction << std::endl;
-                std::string name;
-                bool invalid_msg = false;
-                for (int i = 0; i < ret - 13; i++) {
-                    uint8_t c = in_msg.player_name[i];
-                    if (c < 33 || c > 126) {
-                        invalid_msg = true;
-                        break;
-                    }
-                    name += c;
-                }
-                if (invalid_msg || name.length() > MAX_NAME_LEN)
-                    continue;
+        uint64_t deadline = (uint64_t) backend.round_deadline.tv_sec * 1000000000 +
+                            backend.round_deadline.tv_nsec;
+        uint64_t exp = 0;
+        while (deadline <= timespec_ns(now)) {
+            deadline += backend.round_interval_ns;
+            exp++;
+        }
+        backend.round_deadline.tv_sec = (int64_t) (deadline / 1000000000);
+        backend.round_deadline.tv_nsec = (long long) (deadline % 1000000000);
+        return exp;
+    }
 
-                std::cout << name << std::endl;
+    bool init_uring_backend(uring_backend_t &backend, int rounds_per_sec) {
+        if (!uring_init(backend.ring, URING_ENTRIES, URING_CQ_ENTRIES))
+            return false;
+        if (!uring_buf_ring_init(backend.ring, backend.bufs, 0, URING_RECV_BUFFERS,
+                                 URING_RECV_BUFFER_SIZE)) {
+            uring_exit(backend.ring);   // wracamy do epoll, pierścień nie może zostać otwarty
+            return false;
+        }
+        // dalsze błędy kończą program przez syserr, więc nie trzeba już sprzątać
 
-                if (name.empty()) {
-                    std::cout << "OBSERWATOR\n";
-                    /* obserwator */
-                    if (observers.find(client_id) == observers.end()) {
-                        /* nowy obserwator */
-                        observers.insert(client_id);
+        // odebrany datagram: io_uring_recvmsg_out, adres nadawcy, treść
+        backend.recv_hdr = {};
+        backend.recv_hdr.msg_namelen = sizeof(sockaddr_in6);
 
-                        send_history(expected_event_no, client_address, buf, game_events);
+        backend.round_interval_ns = 1000000000 / rounds_per_sec;
+        timespec now{};
+        if (clock_gettime(CLOCK_MONOTONIC, &now) == -1)
+            syserr("clock_gettime");
+        uint64_t first = timespec_ns(now) + backend.round_interval_ns;
+        backend.round_deadline.tv_sec = (int64_t) (first / 1000000000);
+        backend.round_deadline.tv_nsec = (long long) (first % 1000000000);
+        return true;
+    }
 
-                        for (int i = 2; i < CLIENT_MAX; i++) {
-                            if (poll_arr[i].fd == -1) {
-                                create_timer(poll_arr[i].fd, TIMER_TIMEOUT, -1);
-                                client_poll_position.insert(std::pair(client_id, i));
-                                break;
-                            }
-                        }
-                    }
-                    else {
-                        /* stary obserwator */
-                        send_history(expected_event_no, client_address, buf, game_events);
+    void handle_uring_recv(uring_backend_t &backend, room_t &room, size_t r,
+                           io_uring_cqe *cqe, client_msg &in_msg) {
+        if (!(cqe->flags & IORING_CQE_F_MORE))
+            uring_arm_recv(backend, room, r);   // multishot się zakończył (np. zabrakło buforów), zgłaszamy ponownie
 
-                        int poll_position = client_poll_position[client_id];
-                        update_timer(poll_arr[poll_position]);
-                    }
-                    continue;
-                }
+        if (cqe->res < 0 || !(cqe->flags & IORING_CQE_F_BUFFER))
+            return;
 
-                if (players.find(name) == players.end()) {
-                    /* nowy gracz */
-                    std::cout << "NOWY GRACZ\n";
-                    if (player_ids.find(client_id) != player_ids.end())
-                        continue;   // ignorujemy, znana sesja nie może ot tak zmienić nazwy gracza
+        uint16_t bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        char *buf = uring_buf(backend.bufs, bid);
+        auto *out = (io_uring_recvmsg_out *) buf;
+        sockaddr_in6 client_address{};
+        memcpy(&client_address, buf + sizeof(*out), sizeof(client_address));
+        char *payload = buf + sizeof(*out) + backend.recv_hdr.msg_namelen;
 
-                    player_ids.insert(std::pair(client_id, name));
-                    player_info_t new_player_info{false, -1, client_id, false, false,
-                                                  0, 0, 0, turn_direction, client_address};
+        int len = (int) std::min<uint32_t>(out->payloadlen, sizeof(client_msg));
+        memcpy(&in_msg, payload, len);
+        uring_buf_recycle(backend.bufs, bid);
 
-                    if (new_player_info.turn_direction != 0) {
-                        new_player_info.ready = true;
-                        ready_players++;
-                    }
+        room_handle_client_msg(room, in_msg, len, client_address);
+    }
 
-                    players.insert(std::pair(name, new_player_info));
+    void run_uring_loop(worker_t &worker, uring_backend_t &backend) {
+        std::vector<room_t> &rooms = worker.rooms;
+        client_msg in_msg{};
+        bool round_pending = false;
+        uint64_t pending_exp = 0;
 
-                    send_history(expected_event_no, client_address, buf, game_events);
+        for (size_t r = 0; r < rooms.size(); r++) {
+            rooms[r].send = uring_queue_sends;
+            rooms[r].send_ctx = &backend;
+            uring_arm_recv(backend, rooms[r], r);
+        }
+        uring_arm_round_timer(backend);
 
-                    for (int i = 2; i < CLIENT_MAX; i++) {
-                        if (poll_arr[i].fd == -1) {
-                            create_timer(poll_arr[i].fd, TIMER_TIMEOUT, -1);
-                            client_poll_position.insert(std::pair(client_id, i));
-                            break;
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "EndlessLoop"
+        while (true) {
+            uring_submit(backend.ring, 1);
+
+            io_uring_cqe *cqe;
+            while ((cqe = uring_peek_cqe(backend.ring)) != NULL) {
+                size_t r = cqe->user_data >> URING_OP_BITS;
+                switch (cqe->user_data & ((1 << URING_OP_BITS) - 1)) {
+                    case URING_RECV:
+                        if (round_pending)
+                            backend.deferred_recvs.push_back(*cqe);    // bufor wraca do jądra po turze
+                        else
+                            handle_uring_recv(backend, rooms[r], r, cqe, in_msg);
+                        break;
+                    case URING_ROUND:
+                        if (worker.metrics != nullptr)
+                            metric_record(worker.metrics->round_lateness_ns,
+                                          metrics_now_ns() - ((uint64_t) backend.round_deadline.tv_sec * 1000000000 +
+                                                              backend.round_deadline.tv_nsec));
+                        pending_exp += uring_next_round_deadline(backend);
+                        round_pending = true;
+                        uring_arm_round_timer(backend);
+                        break;
+                    default: // URING_SEND
+                        backend.sends_in_flight--;
+                        if (worker.metrics != nullptr) {
+                            if (cqe->res >= 0) {
+                                metric_add(worker.metrics->datagrams_out, 1);
+                                metric_add(worker.metrics->bytes_out, cqe->res);
+                            } else {
+                                metric_add(worker.metrics->dropped_sends, 1);
+                            }
                         }
-                    }
+                        break;
                 }
-                else {
-                    /* znany gracz */
-                    std::cout << "ZNANY GRACZ\n";
-                    player_info_t &player = players[name];
-                    if (session_id < player.id.session_id || players[name].disconnected)
-                        continue;
-                    else {
-                        // update id i związanych struktur danych
-                        client_id_t &old_id = player.id;
-                        int16_t poll_position = client_poll_position[old_id];
-                        player.id = client_id;
-
-                        client_poll_position.erase(old_id);
-                        client_poll_position.insert(std::pair(client_id, poll_position));
-                        player_ids.erase(old_id);
-                        player_ids.insert(std::pair(client_id, name));
-                    }
+                uring_cqe_seen(backend.ring);
+            }
 
-                    player.turn_direction = turn_direction;
-                    if (!player.ready && turn_direction != 0) {
-                        player.ready = true;
-                        ready_players++;
-                    }
-                    int poll_position = client_poll_position[client_id];
-                    update_timer(poll_arr[poll_position]);
+            if (round_pending && backend.sends_in_flight == 0) {
+                backend.sends.clear();
+                for (room_t &room : rooms)
+                    room_handle_round(room, pending_exp);
+                round_pending = false;
+                pending_exp = 0;
 
-                    send_history(expected_event_no, client_address, buf, game_events);
+                for (io_uring_cqe &deferred : backend.deferred_recvs) {
+                    size_t r = deferred.user_data >> URING_OP_BITS;
+                    handle_uring_recv(backend, rooms[r], r, &deferred, in_msg);
                 }
+                backend.deferred_recvs.clear();
             }
         }
+#pragma clang diagnostic pop
+    }
 
-        kick_timeouted_clients(poll_arr, players, observers, client_poll_position,
-                               player_ids, game_in_progress, ready_players);
-
-        if (poll_arr[1].revents & POLLIN) {
-            /* Czas przeliczyć turę */
-            std::cout << "TURA\n";
-            uint64_t exp;
-            read(poll_arr[1].fd, &exp, sizeof(uint64_t));
-            poll_arr[1].revents = 0;
-
-            if (game_in_progress) {
-                do_turn(players, observers, board, game_events, game_in_progress);
-            } else if (ready_players >= 2 && ready_players == player_ids.size()) {
-                std::cout << "ZACZYNAM GRĘ\n";
-                game_in_progress = true;
-                init_game(players, observers, board, game_events, game_in_progress);
+    void run_worker(worker_t &worker) {
+        if (worker.use_uring) {
+            uring_backend_t backend;
+            if (init_uring_backend(backend, worker.rooms[0].config.rounds_per_sec)) {
+                run_uring_loop(worker, backend);
+                return;
             }
+            LOG_WARN("io_uring unavailable (%s), falling back to epoll", strerror(errno));
+        }
+        run_epoll_loop(worker);
+    }
 
-            bool any_player_in_game = false;
-            for (auto &pair : players) {
-                if (pair.second.in_game) {
-                    any_player_in_game = true;
-                    break;
-                }
-            }
+}
 
-            if (!game_in_progress && any_player_in_game) {
-                // gra się właśnie zakończyła
-                std::cout << "\n\n GAME OVER \n\n";
-                game_events.clear();
-                for (auto &pair : players) {
-                    player_info_t &player = pair.second;
-                    std::cout << pair.first << std::endl;
-                    player.ready = false;
-                    player.in_game = false;
-                    if (player.disconnected) {
-                        std::cout << pair.first << std::endl;
-                        poll_arr[client_poll_position[player.id]].revents = 0;
-                        poll_arr[client_poll_position[player.id]].fd = -1;
-                        client_poll_position.erase(player.id);
-                        players.erase(pair.first);
-                        player_ids.erase(player.id);
-                    }
-                }
-                ready_players = 0;
-            }
+int main(int argc, char *argv[]) {
+    my_rand = (uint32_t)time(NULL);
+
+    get_args(argc, argv);
+    log_init(async_log);
+
+    if (!replay_path.empty()) {
+        replay_result_t result;
+        replay_run(replay_path, result);
+        printf("rounds %lu\nmsgs %lu\ngames %lu\nevents %lu\ndatagrams_out %lu\nbytes_out %lu\n"
+               "digest %08x\nelapsed_ms %lu\n", (unsigned long) result.rounds, (unsigned long) result.msgs,
+               (unsigned long) result.games, (unsigned long) result.events, (unsigned long) result.datagrams_out,
+               (unsigned long) result.bytes_out, result.digest, (unsigned long) (result.elapsed_ns / 1000000));
+        return 0;
+    }
+
+    room_config_t config{turning_speed, rounds_per_sec, board_width, board_height, fixed_point};
+
+    if (worker_count == 0)
+        worker_count = (int) std::max(1U, std::thread::hardware_concurrency());
+    worker_count = std::min(worker_count, room_count);
+
+    /* pokoje rozdzielone po równo między wątki; gniazda tworzymy tutaj, żeby błąd
+     * bind zgłosić przed uruchomieniem czegokolwiek */
+    std::vector<worker_t> workers(worker_count);
+    for (int w = 0; w < worker_count; w++)
+        workers[w].rooms.resize((room_count - w + worker_count - 1) / worker_count);
+
+    std::vector<std::unique_ptr<recorder_t>> recorders;
+    for (int i = 0; i < room_count; i++) {
+        worker_t &worker = workers[i % worker_count];
+        room_t &room = worker.rooms[i / worker_count];
+        room_init(room, i, create_room_socket(port + i), config, room_seed(my_rand, i));
+        if (!multicast_group.empty()) {
+            room.multicast = true;
+            room.multicast_group = resolve_multicast_group(multicast_port + i);
+            enable_multicast_loop(room.socket);
+        }
+        if (!record_path.empty()) {
+            recorder_t &recorder = *recorders.emplace_back(std::make_unique<recorder_t>());
+            record_open(recorder, room_count == 1 ? record_path : record_path + "." + std::to_string(i),
+                        room_seed(my_rand, i), config);
+            room.recorder = &recorder;
         }
     }
-#pragma clang diagnostic pop
+
+    if (metrics_port != 0) {
+        std::vector<metrics_t *> sources;
+        for (worker_t &worker : workers) {
+            worker.metrics = std::make_unique<metrics_t>();
+            for (room_t &room : worker.rooms)
+                room.metrics = worker.metrics.get();
+            sources.push_back(worker.metrics.get());
+        }
+        std::thread(metrics_serve, metrics_listen(metrics_port), std::move(sources)).detach();
+    }
+
+    for (worker_t &worker : workers) {
+        worker.use_uring = use_uring;
+        worker.thread = std::thread(run_worker, std::ref(worker));
+    }
+    for (worker_t &worker : workers)
+        worker.thread.join();
+
     return 0;
-};
\ No newline at end of file
+};
@@ -0,0 +1,108 @@
+#include <cstring>
+#include "session_table.h"
+
+#define SESSION_TABLE_MIN_BUCKETS 16
+
+namespace {
+    inline uint64_t mix(uint64_t a, uint64_t b) {
+        __uint128_t r = (__uint128_t) a * b;
+        return (uint64_t) r ^ (uint64_t) (r >> 64);
+    }
+
+    /* wstawia do kubełków bez sprawdzania, czy slot już tam jest */
+    void bucket_insert(session_table_t &table, uint32_t hash, uint32_t slot) {
+        size_t mask = table.buckets.size() - 1;
+        size_t i = hash & mask;
+        while (table.buckets[i].slot != SESSION_NONE)
+            i = (i + 1) & mask;
+        table.buckets[i] = {hash, slot};
+    }
+
+    void rehash(session_table_t &table, size_t bucket_count) {
+        table.buckets.assign(bucket_count, {0, SESSION_NONE});
+        for (uint32_t slot = 0; slot < table.sessions.size(); slot++) {
+            if (table.sessions[slot].live)
+                bucket_insert(table, (uint32_t) client_id_hash(table, table.sessions[slot].id), slot);
+        }
+    }
+}
+
+void session_table_init(session_table_t &table, uint64_t seed) {
+    table.seed = seed;
+    table.sessions.clear();
+    table.free_slots.clear();
+    table.count = 0;
+    table.buckets.assign(SESSION_TABLE_MIN_BUCKETS, {0, SESSION_NONE});
+}
+
+uint64_t client_id_hash(const session_table_t &table, const client_id_t &id) {
+    uint64_t addr[2];
+    memcpy(addr, &id.addr, sizeof(addr));
+    return mix(id.session_id ^ table.seed, addr[0] ^ 0x9e3779b97f4a7c15) ^
+           mix(addr[1] ^ 0xbf58476d1ce4e5b9, (uint64_t) id.port ^ table.seed ^ 0x94d049bb133111eb);
+}
+
+uint32_t session_find(const session_table_t &table, const client_id_t &id) {
+    uint32_t hash = (uint32_t) client_id_hash(table, id);
+    size_t mask = table.buckets.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        const session_bucket_t &bucket = table.buckets[i];
+        if (bucket.slot == SESSION_NONE)
+            return SESSION_NONE;
+        if (bucket.hash == hash && table.sessions[bucket.slot].id == id)
+            return bucket.slot;
+    }
+}
+
+uint32_t session_insert(session_table_t &table, const client_id_t &id, uint8_t role,
+                        const sockaddr_in6 &address) {
+    // zapełnienie kubełków najwyżej 3/4
+    if ((table.count + 1) * 4 > table.buckets.size() * 3)
+        rehash(table, table.buckets.size() * 2);
+
+    uint32_t slot;
+    if (!table.free_slots.empty()) {
+        slot = table.free_slots.back();
+        table.free_slots.pop_back();
+    } else {
+        slot = (uint32_t) table.sessions.size();
+        table.sessions.emplace_back();
+    }
+
+    session_t &session = table.sessions[slot];
+    session.id = id;
+    session.generation++;
+    session.live = true;
+    session.role = role;
+    session.player = 0;
+    session.deadline = 0;
+    session.multicast = false;
+    session.address = address;
+
+    bucket_insert(table, (uint32_t) client_id_hash(table, id), slot);
+    table.count++;
+    return slot;
+}
+
+void session_erase(session_table_t &table, uint32_t slot) {
+    session_t &session = table.sessions[slot];
+    size_t mask = table.buckets.size() - 1;
+    size_t i = client_id_hash(table, session.id) & mask;
+    while (table.buckets[i].slot != slot)
+        i = (i + 1) & mask;
+
+    /* przesuwamy wstecz kolejne kubełki z ciągu, które mogą zająć zwolnione miejsce,
+     * żeby wyszukiwanie nie kończyło się na dziurze przed nimi */
+    for (size_t j = (i + 1) & mask; table.buckets[j].slot != SESSION_NONE; j = (j + 1) & mask) {
+        size_t home = table.buckets[j].hash & mask;
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            table.buckets[i] = table.buckets[j];
+            i = j;
+        }
+    }
+    table.buckets[i] = {0, SESSION_NONE};
+
+    session.live = false;
+    table.free_slots.push_back(slot);
+    table.count--;
+}
@@ -0,0 +1,70 @@
+#ifndef SIK2_SESSION_TABLE_H
+#define SIK2_SESSION_TABLE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include <netinet/in.h>
+
+#define SESSION_NONE UINT32_MAX
+
+#define SESSION_PLAYER 0
+#define SESSION_OBSERVER 1
+
+struct client_id_t {
+    uint64_t session_id;
+    in_port_t port;
+    in6_addr addr;
+};
+
+inline bool operator==(const client_id_t &lhs, const client_id_t &rhs) {
+    return lhs.session_id == rhs.session_id && lhs.port == rhs.port &&
+           memcmp(&lhs.addr, &rhs.addr, sizeof(lhs.addr)) == 0;
+}
+
+/* Sesja klienta (gracza albo obserwatora). Indeks slotu w session_table_t::sessions
+ * nie zmienia się przez cały czas życia sesji, więc można go trzymać w innych
+ * strukturach zamiast client_id_t. */
+struct session_t {
+    client_id_t id;
+    uint32_t generation;    // zwiększane przy każdym ponownym użyciu slotu
+    bool live;
+    uint8_t role;           // SESSION_PLAYER albo SESSION_OBSERVER
+    uint32_t player;        // indeks w room_t::players, tylko dla SESSION_PLAYER
+    uint64_t deadline;      // termin zerwania połączenia, w turach
+    bool multicast;         // klient odbiera eventy na żywo z grupy multicast (CLIENT_CAP_MULTICAST)
+    sockaddr_in6 address;   // gotowy adres do wysyłania
+};
+
+/* Tablica haszująca z adresowaniem otwartym (liniowe próbkowanie, usuwanie przez
+ * przesuwanie wstecz, bez nagrobków) z client_id_t w gęstą tablicę sesji. Kubełek
+ * trzyma młodsze 32 bity hasha, więc porównanie client_id_t robimy tylko przy
+ * zgodnym hashu. */
+struct session_bucket_t {
+    uint32_t hash;
+    uint32_t slot;          // SESSION_NONE - pusty kubełek
+};
+
+struct session_table_t {
+    uint64_t seed = 0;      // losowy, żeby klienci nie mogli celowo tworzyć kolizji
+    std::vector<session_t> sessions;
+    std::vector<uint32_t> free_slots;
+    std::vector<session_bucket_t> buckets;  // rozmiar to potęga dwójki
+    size_t count = 0;
+};
+
+void session_table_init(session_table_t &table, uint64_t seed);
+
+uint64_t client_id_hash(const session_table_t &table, const client_id_t &id);
+
+/* slot sesji albo SESSION_NONE */
+uint32_t session_find(const session_table_t &table, const client_id_t &id);
+
+/* id nie może być jeszcze w tablicy; zwraca slot nowej sesji */
+uint32_t session_insert(session_table_t &table, const client_id_t &id, uint8_t role,
+                        const sockaddr_in6 &address);
+
+void session_erase(session_table_t &table, uint32_t slot);
+
+#endif //SIK2_SESSION_TABLE_H
@@ -0,0 +1,37 @@
+#include <algorithm>
+#include "timeout_wheel.h"
+
+void timeout_wheel_init(timeout_wheel_t &wheel, uint64_t timeout) {
+    wheel.timeout = timeout;
+    size_t size = 1;
+    while (size <= timeout)
+        size <<= 1;
+    wheel.slots.resize(size);
+}
+
+void timeout_wheel_add(timeout_wheel_t &wheel, session_table_t &table, uint32_t slot) {
+    session_t &session = table.sessions[slot];
+    session.deadline = wheel.now + wheel.timeout;
+    wheel.slots[session.deadline & (wheel.slots.size() - 1)].push_back({slot, session.generation});
+}
+
+void timeout_wheel_advance(timeout_wheel_t &wheel, const session_table_t &table, uint64_t ticks,
+                           std::vector<timeout_entry_t> &expired) {
+    size_t mask = wheel.slots.size() - 1;
+    uint64_t steps = std::min<uint64_t>(ticks, wheel.slots.size());
+    wheel.now += ticks;
+
+    for (uint64_t i = 0; i < steps; i++) {
+        wheel.due.swap(wheel.slots[(wheel.now - i) & mask]);
+        for (timeout_entry_t &entry : wheel.due) {
+            if (!timeout_entry_valid(table, entry))
+                continue;   // sesja już usunięta
+            uint64_t deadline = table.sessions[entry.slot].deadline;
+            if (deadline <= wheel.now)
+                expired.push_back(entry);
+            else
+                wheel.slots[deadline & mask].push_back(entry);
+        }
+        wheel.due.clear();
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef SIK2_TIMEOUT_WHEEL_H
+#define SIK2_TIMEOUT_WHEEL_H
+
+#include <cstdint>
+#include <vector>
+#include "session_table.h"
+
+/* wpis koła czasowego; nieaktualny, jeśli slot sesji został w międzyczasie zwolniony
+ * albo użyty ponownie (inna generacja) */
+struct timeout_entry_t {
+    uint32_t slot;
+    uint32_t generation;
+};
+
+/* Koło czasowe terminów zerwania połączenia z sesjami z session_table_t, liczonych
+ * w tyknięciach timera właściciela (tury pokoju w serwerze, tyknięcia timera komunikatów
+ * w przekaźniku). Odświeżenie terminu to tylko zapis do session_t::deadline - wpis w kole jest
+ * sprawdzany (i ewentualnie przekładany na nowy termin) dopiero gdy koło do niego dojdzie. */
+struct timeout_wheel_t {
+    uint64_t now = 0;
+    uint64_t timeout = 0;
+    std::vector<std::vector<timeout_entry_t>> slots;    // rozmiar to potęga dwójki > timeout
+    std::vector<timeout_entry_t> due;
+};
+
+void timeout_wheel_init(timeout_wheel_t &wheel, uint64_t timeout);
+
+/* wstawia do koła nową sesję z terminem now + timeout */
+void timeout_wheel_add(timeout_wheel_t &wheel, session_table_t &table, uint32_t slot);
+
+inline void timeout_wheel_refresh(const timeout_wheel_t &wheel, session_table_t &table, uint32_t slot) {
+    table.sessions[slot].deadline = wheel.now + wheel.timeout;
+}
+
+inline bool timeout_entry_valid(const session_table_t &table, const timeout_entry_t &entry) {
+    const session_t &session = table.sessions[entry.slot];
+    return session.live && session.generation == entry.generation;
+}
+
+/* przesuwa koło o ticks tyknięć i dopisuje do expired sesje, których termin minął;
+ * usunięcie ich z tablicy należy do wywołującego */
+void timeout_wheel_advance(timeout_wheel_t &wheel, const session_table_t &table, uint64_t ticks,
+                           std::vector<timeout_entry_t> &expired);
+
+#endif //SIK2_TIMEOUT_WHEEL_H
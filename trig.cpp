@@ -0,0 +1,43 @@
+#include <cmath>
+#include <vector>
+#include "trig.h"
+
+namespace {
+    /* https://stackoverflow.com/questions/31502120/sin-and-cos-give-unexpected-results-for-well-known-angles */
+    inline double degree_to_radian(double d) {
+        return (d / 180.0) * ((double) M_PI);
+    }
+
+    /* Kierunek nie jest normalizowany do [0, 360), a cos i sin kątów różniących się
+     * o wielokrotność 360 stopni różnią się na ostatnich bitach, więc tablica obejmuje
+     * cały zakres int16_t zamiast 360 kątów. Liczona przez libm przy starcie, a nie
+     * constexpr, żeby wartości były identyczne z tymi z std::cos/std::sin w runtime. */
+    std::vector<direction_step_t> make_direction_steps() {
+        std::vector<direction_step_t> steps(DIRECTION_STEPS);
+        for (int d = INT16_MIN; d <= INT16_MAX; d++) {
+            double direction = degree_to_radian(d);
+            steps[(uint16_t) d] = {std::cos(direction), std::sin(direction)};
+        }
+        return steps;
+    }
+
+    std::vector<fixed_step_t> make_fixed_direction_steps() {
+        const direction_step_t *steps = direction_steps();
+        std::vector<fixed_step_t> fixed_steps(DIRECTION_STEPS);
+        for (size_t i = 0; i < DIRECTION_STEPS; i++) {
+            fixed_steps[i] = {std::llround(steps[i].dx * (double) FIXED_ONE),
+                              std::llround(steps[i].dy * (double) FIXED_ONE)};
+        }
+        return fixed_steps;
+    }
+}
+
+const direction_step_t *direction_steps() {
+    static const std::vector<direction_step_t> steps = make_direction_steps();
+    return steps.data();
+}
+
+const fixed_step_t *fixed_direction_steps() {
+    static const std::vector<fixed_step_t> steps = make_fixed_direction_steps();
+    return steps.data();
+}
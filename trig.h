@@ -0,0 +1,58 @@
+#ifndef SIK2_TRIG_H
+#define SIK2_TRIG_H
+
+#include <cstdint>
+
+#define DIRECTION_STEPS 65536   // każda wartość int16_t kierunku
+
+/* przesunięcie gracza w jednej turze */
+struct direction_step_t {
+    double dx;
+    double dy;
+};
+
+/* Tablica kroków indeksowana (uint16_t) kierunkiem w stopniach. Wartości są dokładnie
+ * tymi, które dają cos i sin z kąta w radianach (d / 180.0) * M_PI, więc ruch z tablicy
+ * jest bit w bit taki sam jak liczony wprost. */
+const direction_step_t *direction_steps();
+
+inline const direction_step_t &direction_step(const direction_step_t *steps, int16_t direction) {
+    return steps[(uint16_t) direction];
+}
+
+/* Ruch stałoprzecinkowy: pozycja i krok jako 32.32 w int64_t. Wynik zależy tylko od
+ * arytmetyki całkowitej, więc jest taki sam na każdej maszynie. */
+#define FIXED_FRACTION_BITS 32
+#define FIXED_ONE ((int64_t) 1 << FIXED_FRACTION_BITS)
+
+struct fixed_step_t {
+    int64_t dx;
+    int64_t dy;
+};
+
+/* kroki z direction_steps() zaokrąglone do 32.32 */
+const fixed_step_t *fixed_direction_steps();
+
+inline const fixed_step_t &fixed_direction_step(const fixed_step_t *steps, int16_t direction) {
+    return steps[(uint16_t) direction];
+}
+
+/* środek pola planszy */
+inline int64_t fixed_from_cell(uint32_t cell) {
+    return ((int64_t) cell << FIXED_FRACTION_BITS) + FIXED_ONE / 2;
+}
+
+/* pole planszy z pozycji, z obcięciem w stronę zera jak przy konwersji double na uint32_t
+ * (pozycja z (-1, 0) daje pole 0, bardziej ujemna - wartość spoza planszy) */
+inline uint32_t fixed_to_cell(int64_t position) {
+    return (uint32_t) (position / FIXED_ONE);
+}
+
+/* Równoważność z ruchem na double (sprawdzana w bench): krok stałoprzecinkowy różni się od
+ * kroku z direction_steps() o najwyżej 2^-33, a dodawanie na double przy planszy do 4096 gubi
+ * najwyżej 2^-41 na turę, więc po n turach pozycje różnią się mniej niż n * 2^-32. Pole planszy
+ * różni się tylko, gdy pozycja leży w tej odległości od granicy pola (np. krok 0.49999999999999994 przy
+ * kierunku 30 stopni); dla domyślnego turning_speed 6 na planszy 640x480 dotyczy to ok. 0.2%
+ * losowych tras. */
+
+#endif //SIK2_TRIG_H
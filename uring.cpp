@@ -0,0 +1,166 @@
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "common.h"
+#include "uring.h"
+
+namespace {
+    int io_uring_setup(unsigned entries, io_uring_params *params) {
+        return (int) syscall(__NR_io_uring_setup, entries, params);
+    }
+
+    int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+        return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+    }
+
+    int io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+        return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+    }
+}
+
+bool uring_init(uring_t &ring, unsigned entries, unsigned cq_entries) {
+    io_uring_params params{};
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL;
+    params.cq_entries = cq_entries;
+
+    ring.fd = io_uring_setup(entries, &params);
+    if (ring.fd < 0)
+        return false;
+
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP)) {
+        close(ring.fd);
+        ring.fd = -1;
+        errno = ENOSYS;
+        return false;
+    }
+
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    size_t ring_size = sq_size > cq_size ? sq_size : cq_size;
+
+    // SQ i CQ są w jednym mapowaniu (IORING_FEAT_SINGLE_MMAP)
+    char *ring_mem = (char *) mmap(NULL, ring_size, PROT_READ | PROT_WRITE,
+                                   MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQ_RING);
+    if (ring_mem == MAP_FAILED)
+        syserr("mmap io_uring ring");
+    ring.ring_mem = ring_mem;
+    ring.ring_size = ring_size;
+
+    ring.sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    ring.sqes = (io_uring_sqe *) mmap(NULL, ring.sqes_size, PROT_READ | PROT_WRITE,
+                                      MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQES);
+    if (ring.sqes == MAP_FAILED)
+        syserr("mmap io_uring sqes");
+
+    ring.sq_head = (unsigned *) (ring_mem + params.sq_off.head);
+    ring.sq_tail = (unsigned *) (ring_mem + params.sq_off.tail);
+    ring.sq_mask = (unsigned *) (ring_mem + params.sq_off.ring_mask);
+    ring.sq_array = (unsigned *) (ring_mem + params.sq_off.array);
+    ring.sq_entries = params.sq_entries;
+    ring.sq_local_tail = *ring.sq_tail;
+
+    ring.cq_head = (unsigned *) (ring_mem + params.cq_off.head);
+    ring.cq_tail = (unsigned *) (ring_mem + params.cq_off.tail);
+    ring.cq_mask = (unsigned *) (ring_mem + params.cq_off.ring_mask);
+    ring.cqes = (io_uring_cqe *) (ring_mem + params.cq_off.cqes);
+    return true;
+}
+
+void uring_exit(uring_t &ring) {
+    int saved_errno = errno;
+    munmap(ring.sqes, ring.sqes_size);
+    munmap(ring.ring_mem, ring.ring_size);
+    close(ring.fd);
+    ring.fd = -1;
+    errno = saved_errno;
+}
+
+io_uring_sqe *uring_get_sqe(uring_t &ring) {
+    unsigned head = __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+    if (ring.sq_local_tail - head >= ring.sq_entries) {
+        uring_submit(ring, 0);
+        head = __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+        if (ring.sq_local_tail - head >= ring.sq_entries)
+            return NULL;    // jądro nie pobrało zgłoszeń, nie nadpisujemy żadnego z nich
+    }
+
+    unsigned index = ring.sq_local_tail & *ring.sq_mask;
+    ring.sq_array[index] = index;
+    ring.sq_local_tail++;
+
+    io_uring_sqe *sqe = &ring.sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+void uring_submit(uring_t &ring, unsigned wait_nr) {
+    unsigned to_submit = ring.sq_local_tail - *ring.sq_tail;
+    __atomic_store_n(ring.sq_tail, ring.sq_local_tail, __ATOMIC_RELEASE);
+
+    unsigned flags = wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0;
+    while (io_uring_enter(ring.fd, to_submit, wait_nr, flags) < 0) {
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+            syserr("io_uring_enter");
+        // przerwane - zgłoszenia, których jądro nie pobrało, wyśle kolejne wywołanie
+        to_submit = ring.sq_local_tail - __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+    }
+}
+
+io_uring_cqe *uring_peek_cqe(uring_t &ring) {
+    unsigned head = *ring.cq_head;
+    if (head == __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE))
+        return NULL;
+    return &ring.cqes[head & *ring.cq_mask];
+}
+
+void uring_cqe_seen(uring_t &ring) {
+    __atomic_store_n(ring.cq_head, *ring.cq_head + 1, __ATOMIC_RELEASE);
+}
+
+bool uring_buf_ring_init(uring_t &ring, uring_buf_ring_t &br, uint16_t bgid,
+                         unsigned entries, unsigned buf_size) {
+    br.entries = entries;
+    br.buf_size = buf_size;
+    br.bgid = bgid;
+
+    br.ring = (io_uring_buf *) mmap(NULL, entries * sizeof(io_uring_buf), PROT_READ | PROT_WRITE,
+                                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (br.ring == MAP_FAILED)
+        syserr("mmap io_uring buffer ring");
+
+    br.bufs = (char *) mmap(NULL, (size_t) entries * buf_size, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (br.bufs == MAP_FAILED)
+        syserr("mmap io_uring buffers");
+
+    // zapis przed rejestracją, żeby jądro przypięło już zaalokowaną stronę, a nie stronę zerową
+    br.ring[0].resv = 0;
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = (uint64_t) br.ring;
+    reg.ring_entries = entries;
+    reg.bgid = bgid;
+    if (io_uring_register(ring.fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        int saved_errno = errno;
+        munmap(br.bufs, (size_t) entries * buf_size);
+        munmap(br.ring, entries * sizeof(io_uring_buf));
+        errno = saved_errno;
+        return false;
+    }
+
+    for (unsigned bid = 0; bid < entries; bid++)
+        uring_buf_recycle(br, (uint16_t) bid);
+    return true;
+}
+
+void uring_buf_recycle(uring_buf_ring_t &br, uint16_t bid) {
+    uint16_t *tail = &br.ring[0].resv;  // ogon pierścienia nałożony na pole resv pierwszego wpisu
+    uint16_t t = *tail;
+    io_uring_buf &buf = br.ring[t & (br.entries - 1)];
+    buf.addr = (uint64_t) uring_buf(br, bid);
+    buf.len = br.buf_size;
+    buf.bid = bid;
+    __atomic_store_n(tail, (uint16_t) (t + 1), __ATOMIC_RELEASE);
+}
@@ -0,0 +1,64 @@
+#ifndef SIK2_URING_H
+#define SIK2_URING_H
+
+#include <cstdint>
+#include <cstddef>
+#include <linux/io_uring.h>
+
+/* Minimalna obsługa io_uring bez liburing: pierścienie zgłoszeń (SQ) i zakończeń (CQ)
+ * zmapowane z jądra oraz pierścień buforów do odbioru multishot. */
+struct uring_t {
+    int fd = -1;
+    char *ring_mem;             // wspólne mapowanie SQ i CQ
+    size_t ring_size;
+    size_t sqes_size;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    io_uring_sqe *sqes;
+    unsigned sq_entries;
+    unsigned sq_local_tail;     // zgłoszenia przygotowane, ale jeszcze nie przekazane jądru
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    io_uring_cqe *cqes;
+};
+
+/* Bufory, z których jądro samo wybiera miejsce na kolejny odebrany datagram.
+ * Pierścień to tablica io_uring_buf, a nie io_uring_buf_ring - w C++ pusta struktura
+ * z __DECLARE_FLEX_ARRAY ma rozmiar 1 i przesuwa bufs o 8 bajtów względem jądra. */
+struct uring_buf_ring_t {
+    io_uring_buf *ring;
+    char *bufs;
+    unsigned entries;
+    unsigned buf_size;
+    uint16_t bgid;
+};
+
+/* false, jeśli jądro nie obsługuje io_uring (errno ustawione) */
+bool uring_init(uring_t &ring, unsigned entries, unsigned cq_entries);
+
+/* zwalnia mapowania i zamyka pierścień; zachowuje errno, żeby wywołujący mógł zgłosić
+ * przyczynę wcześniejszego błędu */
+void uring_exit(uring_t &ring);
+
+/* kolejne wolne zgłoszenie (wyzerowane); przy pełnej kolejce najpierw wysyła przygotowane,
+ * a jeśli jądro nie zwolniło przy tym miejsca, zwraca NULL */
+io_uring_sqe *uring_get_sqe(uring_t &ring);
+
+/* przekazuje jądru przygotowane zgłoszenia i czeka na co najmniej wait_nr zakończeń */
+void uring_submit(uring_t &ring, unsigned wait_nr);
+
+/* najstarsze nieprzetworzone zakończenie albo NULL */
+io_uring_cqe *uring_peek_cqe(uring_t &ring);
+void uring_cqe_seen(uring_t &ring);
+
+/* false, jeśli jądro nie obsługuje pierścieni buforów (errno ustawione); bufory są
+ * wtedy już zwolnione */
+bool uring_buf_ring_init(uring_t &ring, uring_buf_ring_t &br, uint16_t bgid,
+                         unsigned entries, unsigned buf_size);
+
+inline char *uring_buf(uring_buf_ring_t &br, uint16_t bid) {
+    return br.bufs + (size_t) bid * br.buf_size;
+}
+
+/* oddaje jądru bufor po przetworzeniu datagramu */
+void uring_buf_recycle(uring_buf_ring_t &br, uint16_t bid);
+
+#endif //SIK2_URING_H